@@ -0,0 +1,92 @@
+#ifndef ASSET_IO_H
+#define ASSET_IO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/asset_pack.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+// ASSIMP reading through Assets: the model file and everything it pulls in (glTF buffers) come out of the asset pack
+// when it has them. ASSIMP copies whatever it reads into its own buffers, the stream itself only reads the mapping.
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+    explicit AssetIOStream(std::shared_ptr<MappedFile> file) : file(std::move(file)) {}
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        count = std::min(count, (file->size() - position) / size);
+        memcpy(buffer, file->data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        // like ASSIMP's own MemoryIOStream, aiOrigin_END counts backwards from the end
+        size_t target = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? position + offset : file->size() - offset;
+        if (offset > file->size() || target > file->size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return position;
+    }
+
+    size_t FileSize() const override
+    {
+        return file->size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    std::shared_ptr<MappedFile> file;
+    size_t position = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *path) const override
+    {
+        return Assets::exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        // the assets are read only
+        if (strchr(mode, 'w') || strchr(mode, 'a'))
+            return nullptr;
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        return file ? new AssetIOStream(file) : nullptr;
+    }
+
+    void Close(Assimp::IOStream *stream) override
+    {
+        delete stream;
+    }
+};
+
+#endif
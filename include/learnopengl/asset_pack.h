@@ -0,0 +1,339 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Single file archive of resources/, written by tools/bake_assets.cpp: a Header, every file's contents aligned to
+// ALIGNMENT, then the index (an IndexEntry and the path per file, sorted by path).
+class AssetPack
+{
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t ALIGNMENT = 64;
+
+    struct Entry {
+        std::string path;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t contentHash;
+    };
+
+    // what write() puts into a pack
+    struct Source {
+        std::string path;
+        uint64_t contentHash;
+        std::shared_ptr<MappedFile> data;
+    };
+
+    static std::shared_ptr<AssetPack> open(const std::string &path)
+    {
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (!file || file->size() < sizeof(Header))
+            return nullptr;
+
+        Header header;
+        memcpy(&header, file->data(), sizeof(header));
+        if (memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != VERSION
+            || header.indexOffset > file->size() || header.indexSize > file->size() - header.indexOffset)
+            return nullptr;
+
+        std::shared_ptr<AssetPack> pack(new AssetPack());
+        pack->file = file;
+        const unsigned char *index = file->data() + header.indexOffset;
+        const unsigned char *indexEnd = index + header.indexSize;
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            IndexEntry raw;
+            if ((size_t)(indexEnd - index) < sizeof(raw))
+                return nullptr;
+            memcpy(&raw, index, sizeof(raw));
+            index += sizeof(raw);
+            if ((size_t)(indexEnd - index) < raw.pathLength || raw.offset > file->size() || raw.size > file->size() - raw.offset)
+                return nullptr;
+
+            Entry entry;
+            entry.path.assign(reinterpret_cast<const char*>(index), raw.pathLength);
+            entry.offset = raw.offset;
+            entry.size = raw.size;
+            entry.contentHash = raw.contentHash;
+            index += raw.pathLength;
+            pack->byPath[entry.path] = pack->index.size();
+            pack->index.push_back(entry);
+        }
+        return pack;
+    }
+
+    const Entry *find(const std::string &path) const
+    {
+        std::unordered_map<std::string, size_t>::const_iterator it = byPath.find(path);
+        return it == byPath.end() ? nullptr : &index[it->second];
+    }
+
+    // the contents of entry, sharing the pack's mapping
+    std::shared_ptr<MappedFile> open(const Entry &entry) const
+    {
+        return MappedFile::slice(file, (size_t)entry.offset, (size_t)entry.size);
+    }
+
+    const std::vector<Entry> &entries() const
+    {
+        return index;
+    }
+
+    size_t size() const
+    {
+        return file->size();
+    }
+
+    // writes sources (in the given order, the index gets sorted by path) to path
+    static bool write(const std::string &path, const std::vector<Source> &sources)
+    {
+        // same as the mesh cache: never leave a half written file where the loader would pick it up
+        std::string tmpPath = path + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version = VERSION;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<Entry> entries;
+        uint64_t offset = writeContents(out, sizeof(header), sources, entries);
+        writeIndex(out, offset, entries, header);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        out.close();
+        if (!out)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    // updates the pack in place, sources and a new index go behind the old data and the header switches over last.
+    // What the new index no longer references stays as dead space until the next write().
+    static bool append(const std::string &path, const std::vector<Entry> &kept, const std::vector<Source> &sources)
+    {
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        Header header;
+        if (!out || !out.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || memcmp(header.magic, magic(), sizeof(header.magic)) != 0 || header.version != VERSION)
+            return false;
+
+        out.seekp(0, std::ios::end);
+        std::vector<Entry> entries(kept);
+        uint64_t offset = writeContents(out, (uint64_t)out.tellp(), sources, entries);
+        writeIndex(out, offset, entries, header);
+        out.flush();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t indexOffset;
+        uint64_t indexSize;
+    };
+
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t contentHash;
+        uint32_t pathLength;
+        uint32_t reserved;
+    };
+
+    static const char *magic()
+    {
+        return "LOGLPACK";
+    }
+
+    // the contents of sources from offset on, each aligned, adding their entries. Returns the offset after them.
+    static uint64_t writeContents(std::ostream &out, uint64_t offset, const std::vector<Source> &sources, std::vector<Entry> &entries)
+    {
+        static const char padding[ALIGNMENT] = {};
+        for (const Source &source : sources)
+        {
+            uint64_t aligned = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            out.write(padding, aligned - offset);
+            out.write(reinterpret_cast<const char*>(source.data->data()), source.data->size());
+
+            Entry entry;
+            entry.path = source.path;
+            entry.offset = aligned;
+            entry.size = source.data->size();
+            entry.contentHash = source.contentHash;
+            entries.push_back(entry);
+            offset = aligned + entry.size;
+        }
+        return offset;
+    }
+
+    // the index of entries at offset, sorted by path, and where it went into header
+    static void writeIndex(std::ostream &out, uint64_t offset, std::vector<Entry> &entries, Header &header)
+    {
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.path < b.path; });
+        header.entryCount = (uint32_t)entries.size();
+        header.indexOffset = offset;
+        for (const Entry &entry : entries)
+        {
+            IndexEntry raw;
+            raw.offset = entry.offset;
+            raw.size = entry.size;
+            raw.contentHash = entry.contentHash;
+            raw.pathLength = (uint32_t)entry.path.size();
+            raw.reserved = 0;
+            out.write(reinterpret_cast<const char*>(&raw), sizeof(raw));
+            out.write(entry.path.data(), entry.path.size());
+            offset += sizeof(raw) + entry.path.size();
+        }
+        header.indexSize = offset - header.indexOffset;
+    }
+
+    std::shared_ptr<MappedFile> file;
+    std::vector<Entry> index;
+    std::unordered_map<std::string, size_t> byPath;
+
+    AssetPack() {}
+};
+
+// The files the loaders read, out of the mounted asset pack when it has them and from disk otherwise.
+// Safe from any thread, mount() once before loading. Rerun asset_bake after editing a packed file.
+class Assets
+{
+public:
+    // root is what FileSystem::getPath puts in front of paths, FileSystem::getPath("")
+    static bool mount(const std::string &packPath, const std::string &root)
+    {
+        std::shared_ptr<Mount> mounted = std::make_shared<Mount>();
+        mounted->pack = AssetPack::open(packPath);
+        mounted->root = root;
+        if (!mounted->pack)
+            return false;
+        std::atomic_store(&current(), std::shared_ptr<const Mount>(mounted));
+        std::cout << "ASSETS::MOUNTED " << packPath << ", " << mounted->pack->entries().size() << " files, "
+                  << mounted->pack->size() / (1024 * 1024) << " MiB" << std::endl;
+        return true;
+    }
+
+    static void unmount()
+    {
+        std::atomic_store(&current(), std::shared_ptr<const Mount>());
+    }
+
+    static std::shared_ptr<MappedFile> open(const std::string &path)
+    {
+        std::shared_ptr<const Mount> mounted = std::atomic_load(&current());
+        if (mounted)
+        {
+            if (const AssetPack::Entry *entry = mounted->pack->find(key(path, mounted->root)))
+            {
+                LoadProfiler::bytesRead(entry->size);
+                return mounted->pack->open(*entry);
+            }
+        }
+        std::shared_ptr<MappedFile> file = MappedFile::open(path);
+        if (file)
+            LoadProfiler::bytesRead(file->size());
+        return file;
+    }
+
+    // the whole file as text, for the loaders that need a string anyway (shaders)
+    static bool read(const std::string &path, std::string &contents)
+    {
+        std::shared_ptr<MappedFile> file = open(path);
+        if (!file)
+            return false;
+        contents.assign(reinterpret_cast<const char*>(file->data()), file->size());
+        return true;
+    }
+
+    // hashBytes over the contents of file, which open(path) returned. Packed files have it in the index already.
+    static uint64_t contentHash(const std::string &path, const MappedFile &file)
+    {
+        std::shared_ptr<const Mount> mounted = std::atomic_load(&current());
+        if (mounted)
+        {
+            const AssetPack::Entry *entry = mounted->pack->find(key(path, mounted->root));
+            if (entry && entry->size == file.size())
+                return entry->contentHash;
+        }
+        return hashBytes(file.data(), file.size());
+    }
+
+    static bool packed(const std::string &path)
+    {
+        std::shared_ptr<const Mount> mounted = std::atomic_load(&current());
+        return mounted && mounted->pack->find(key(path, mounted->root)) != nullptr;
+    }
+
+    static bool exists(const std::string &path)
+    {
+        struct stat st;
+        return packed(path) || stat(path.c_str(), &st) == 0;
+    }
+
+    // path relative to root with "." and ".." resolved, what the pack index holds
+    static std::string key(const std::string &path, const std::string &root)
+    {
+        std::string relative = path;
+        if (!root.empty() && relative.compare(0, root.size(), root) == 0)
+            relative = relative.substr(root.size());
+
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= relative.size())
+        {
+            size_t end = std::min(relative.find('/', start), relative.size());
+            std::string part = relative.substr(start, end - start);
+            if (part == ".." && !parts.empty() && parts.back() != ".." && !parts.back().empty())
+                parts.pop_back();
+            else if (part != "." && (!part.empty() || parts.empty()))
+                parts.push_back(part);
+            start = end + 1;
+        }
+
+        std::string normalized;
+        for (size_t i = 0; i < parts.size(); i++)
+            normalized += (i > 0 ? "/" : "") + parts[i];
+        return normalized;
+    }
+
+private:
+    struct Mount {
+        std::shared_ptr<AssetPack> pack;
+        std::string root;
+    };
+
+    static std::shared_ptr<const Mount> &current()
+    {
+        static std::shared_ptr<const Mount> mounted;
+        return mounted;
+    }
+};
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// the block compressed formats the texture baker writes. All of them work on 4x4 pixel blocks.
+enum BlockFormat
+{
+    BC1,    // RGB, 8 bytes per block (DXT1)
+    BC3,    // RGBA, BC1 color plus a BC4 style alpha block, 16 bytes per block (DXT5)
+    BC4,    // single channel, 8 bytes per block (RGTC1)
+    BC5     // two channels (normal map xy), two BC4 blocks, 16 bytes per block (RGTC2)
+};
+
+// 8 bit RGBA pixels, the input of the encoders
+struct RgbaImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+
+    const unsigned char *pixel(int x, int y) const
+    {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return &pixels[((size_t)y * width + x) * 4];
+    }
+};
+
+// CPU encoder for the BC formats, used offline by tools/bake_textures.cpp. Endpoints are fitted along the
+// principal axis of the block's colors.
+class BlockEncoder
+{
+public:
+    static unsigned int blockBytes(BlockFormat format)
+    {
+        return format == BC1 || format == BC4 ? 8 : 16;
+    }
+
+    static size_t levelBytes(BlockFormat format, int width, int height)
+    {
+        return (size_t)std::max(1, (width + 3) / 4) * std::max(1, (height + 3) / 4) * blockBytes(format);
+    }
+
+    static const char *name(BlockFormat format)
+    {
+        switch (format)
+        {
+            case BC1: return "BC1";
+            case BC3: return "BC3";
+            case BC4: return "BC4";
+            default:  return "BC5";
+        }
+    }
+
+    // picks the smallest format that keeps what the texture actually uses: a second channel pair for normal maps,
+    // alpha only when some pixel isn't opaque, a single channel for grey images
+    static BlockFormat chooseFormat(const RgbaImage &image, bool normalMap)
+    {
+        if (normalMap)
+            return BC5;
+
+        bool opaque = true, grey = true;
+        for (size_t i = 0; i < image.pixels.size(); i += 4)
+        {
+            const unsigned char *p = &image.pixels[i];
+            opaque = opaque && p[3] == 255;
+            grey = grey && p[0] == p[1] && p[1] == p[2];
+        }
+        if (!opaque)
+            return BC3;
+        return grey ? BC4 : BC1;
+    }
+
+    // half resolution version of image, 2x2 box filter. Odd edges repeat their last row / column.
+    static RgbaImage downsample(const RgbaImage &image)
+    {
+        RgbaImage half;
+        half.width = std::max(1, image.width / 2);
+        half.height = std::max(1, image.height / 2);
+        half.pixels.resize((size_t)half.width * half.height * 4);
+        for (int y = 0; y < half.height; y++)
+        {
+            for (int x = 0; x < half.width; x++)
+            {
+                const unsigned char *a = image.pixel(2 * x, 2 * y);
+                const unsigned char *b = image.pixel(2 * x + 1, 2 * y);
+                const unsigned char *c = image.pixel(2 * x, 2 * y + 1);
+                const unsigned char *d = image.pixel(2 * x + 1, 2 * y + 1);
+                unsigned char *out = &half.pixels[((size_t)y * half.width + x) * 4];
+                for (int i = 0; i < 4; i++)
+                    out[i] = (unsigned char)((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+            }
+        }
+        return half;
+    }
+
+    // image and all its mip levels down to 1x1, level 0 first
+    static std::vector<RgbaImage> mipChain(const RgbaImage &image)
+    {
+        std::vector<RgbaImage> levels(1, image);
+        while (levels.back().width > 1 || levels.back().height > 1)
+            levels.push_back(downsample(levels.back()));
+        return levels;
+    }
+
+    // encodes a whole image, blocks in rows from the top left like the GL expects them
+    static std::vector<unsigned char> encode(const RgbaImage &image, BlockFormat format)
+    {
+        std::vector<unsigned char> blocks(levelBytes(format, image.width, image.height));
+        unsigned char *out = blocks.data();
+        unsigned char block[16 * 4];
+        for (int by = 0; by < image.height; by += 4)
+        {
+            for (int bx = 0; bx < image.width; bx += 4)
+            {
+                // blocks hanging over the edge repeat the edge pixels
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                        memcpy(&block[(y * 4 + x) * 4], image.pixel(bx + x, by + y), 4);
+                encodeBlock(block, format, out);
+                out += blockBytes(format);
+            }
+        }
+        return blocks;
+    }
+
+    static void encodeBlock(const unsigned char rgba[16 * 4], BlockFormat format, unsigned char *out)
+    {
+        switch (format)
+        {
+            case BC1:
+                encodeColor(rgba, out);
+                break;
+            case BC3:
+                encodeChannel(rgba, 3, out);
+                encodeColor(rgba, out + 8);
+                break;
+            case BC4:
+                encodeChannel(rgba, 0, out);
+                break;
+            case BC5:
+                encodeChannel(rgba, 0, out);
+                encodeChannel(rgba, 1, out + 8);
+                break;
+        }
+    }
+
+private:
+    static uint16_t pack565(const float color[3])
+    {
+        int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+        int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+        int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void unpack565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // 4 color BC1 block: two 565 endpoints and a 2 bit index per pixel
+    static void encodeColor(const unsigned char *rgba, unsigned char *out)
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += rgba[i * 4 + c] / 16.0f;
+
+        float covariance[6] = { 0.0f };  // xx xy xz yy yz zz
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = { rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2] };
+            covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+            covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+        }
+
+        // principal axis by power iteration
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+            };
+            float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+            if (length < 1e-6f)
+                break;  // flat block, any axis will do
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < 3; c++)
+                t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float high[3], low[3];
+        for (int c = 0; c < 3; c++)
+        {
+            high[c] = mean[c] + axis[c] * maxT / axisLength2;
+            low[c] = mean[c] + axis[c] * minT / axisLength2;
+        }
+
+        uint16_t color0 = pack565(high), color1 = pack565(low);
+        // color0 > color1 selects the 4 color mode, equal endpoints mean a single color block
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        int palette[4][3];
+        unpack565(color0, palette[0]);
+        unpack565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = INT32_MAX;
+                for (int p = 0; p < 4; p++)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 3; c++)
+                        error += (rgba[i * 4 + c] - palette[p][c]) * (rgba[i * 4 + c] - palette[p][c]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+
+        out[0] = color0 & 0xff; out[1] = color0 >> 8;
+        out[2] = color1 & 0xff; out[3] = color1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (8 * i)) & 0xff;
+    }
+
+    // 8 value BC4 block for one channel: two 8 bit endpoints and a 3 bit index per pixel
+    static void encodeChannel(const unsigned char *rgba, int channel, unsigned char *out)
+    {
+        int high = 0, low = 255;
+        for (int i = 0; i < 16; i++)
+        {
+            high = std::max(high, (int)rgba[i * 4 + channel]);
+            low = std::min(low, (int)rgba[i * 4 + channel]);
+        }
+
+        // endpoint0 > endpoint1 selects 6 interpolated values in between, index 0 and 1 are the endpoints
+        int palette[8] = { high, low };
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * high + p * low + 3) / 7;
+
+        uint64_t indices = 0;
+        if (high != low)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int value = rgba[i * 4 + channel];
+                int best = 0;
+                for (int p = 1; p < 8; p++)
+                    if (std::abs(value - palette[p]) < std::abs(value - palette[best]))
+                        best = p;
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (8 * i)) & 0xff;
+    }
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef DDS_FILE_H
+#define DDS_FILE_H
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/block_compression.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// glad only knows the core profile, the S3TC formats come from EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RED_RGTC1
+#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#endif
+#ifndef GL_COMPRESSED_RG_RGTC2
+#define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+
+// one mip level of a compressed image, data points into the mapped file
+struct CompressedLevel
+{
+    int width;
+    int height;
+    const unsigned char *data;
+    size_t size;
+};
+
+// a baked texture as it is going to be handed to glCompressedTexImage2D
+struct CompressedImage
+{
+    unsigned int glFormat = 0;
+    BlockFormat format = BC1;
+    std::vector<CompressedLevel> levels;
+    // keeps levels[i].data alive
+    std::shared_ptr<MappedFile> file;
+
+    bool hasAlpha() const { return format == BC3; }
+
+    size_t size() const
+    {
+        size_t bytes = 0;
+        for (const CompressedLevel &level : levels)
+            bytes += level.size;
+        return bytes;
+    }
+};
+
+// Reads and writes the DXT1/DXT5/ATI1/ATI2 .dds files the texture baker produces, cube maps as six faces in a row.
+// The baked variant of a texture lives next to it, barn_baseColor.png -> barn_baseColor.png.dds.
+class DdsFile
+{
+public:
+    static std::string variantPath(const std::string &source)
+    {
+        return source + ".dds";
+    }
+
+    // true if path has a baked variant that is at least as new as path itself (or path is gone). The asset pack only
+    // holds variants asset_bake baked right before packing them.
+    static bool hasFreshVariant(const std::string &path)
+    {
+        if (Assets::packed(variantPath(path)))
+            return true;
+        struct stat variant, source;
+        if (stat(variantPath(path).c_str(), &variant) != 0)
+            return false;
+        return stat(path.c_str(), &source) != 0 || variant.st_mtime >= source.st_mtime;
+    }
+
+    static bool read(const std::string &path, CompressedImage &image)
+    {
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        DdsHeader header;
+        if (!readHeader(file, header, image))
+            return false;
+        size_t offset = 4 + sizeof(DdsHeader);
+        return readLevels(header, offset, image);
+    }
+
+    // A cube map baked from six face images lives next to their directory, skybox/right.jpg ... -> skybox.dds
+    static std::string cubemapPath(const std::vector<std::string> &faces)
+    {
+        return variantPath(faces[0].substr(0, faces[0].find_last_of('/')));
+    }
+
+    // same as hasFreshVariant, for the cube map baked from faces
+    static bool hasFreshCubemap(const std::vector<std::string> &faces)
+    {
+        std::string path = cubemapPath(faces);
+        if (Assets::packed(path))
+            return true;
+        struct stat variant, source;
+        if (stat(path.c_str(), &variant) != 0)
+            return false;
+        for (const std::string &face : faces)
+            if (stat(face.c_str(), &source) == 0 && variant.st_mtime < source.st_mtime)
+                return false;
+        return true;
+    }
+
+    // the six faces (+x, -x, +y, -y, +z, -z) of a cube map file, each with all of its levels, in one mapping
+    static bool readCubemap(const std::string &path, std::vector<CompressedImage> &faces)
+    {
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        DdsHeader header;
+        CompressedImage face;
+        if (!readHeader(file, header, face) || (header.caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+            return false;
+        size_t offset = 4 + sizeof(DdsHeader);
+        faces.clear();
+        for (int i = 0; i < 6; i++)
+        {
+            if (!readLevels(header, offset, face))
+                return false;
+            faces.push_back(face);
+        }
+        return true;
+    }
+
+    // levels are the encoded blocks of every mip level, largest first, level 0 being width x height
+    static bool write(const std::string &path, BlockFormat format, int width, int height,
+                      const std::vector<std::vector<unsigned char>> &levels)
+    {
+        return writeFaces(path, format, width, height, std::vector<std::vector<std::vector<unsigned char>>>(1, levels));
+    }
+
+    // faces in GL order (+x, -x, +y, -y, +z, -z), each the levels of one face like write takes them
+    static bool writeCubemap(const std::string &path, BlockFormat format, int size,
+                             const std::vector<std::vector<std::vector<unsigned char>>> &faces)
+    {
+        return faces.size() == 6 && writeFaces(path, format, size, size, faces);
+    }
+
+    static unsigned int glFormat(BlockFormat format)
+    {
+        switch (format)
+        {
+            case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BC4: return GL_COMPRESSED_RED_RGTC1;
+            default:  return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+private:
+    static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000,
+                          DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+    static const uint32_t DDPF_FOURCC = 0x4;
+    static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+    // the cube map flag and one flag per face
+    static const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0x200 | 0xFC00;
+
+    struct DdsPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+    };
+
+    struct DdsHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat pixelFormat;
+        uint32_t caps, caps2, caps3, caps4;
+        uint32_t reserved2;
+    };
+
+    static bool readHeader(const std::shared_ptr<MappedFile> &file, DdsHeader &header, CompressedImage &image)
+    {
+        if (!file || file->size() < 4 + sizeof(DdsHeader) || memcmp(file->data(), "DDS ", 4) != 0)
+            return false;
+
+        memcpy(&header, file->data() + 4, sizeof(header));
+        if (header.size != sizeof(DdsHeader) || !(header.pixelFormat.flags & DDPF_FOURCC))
+            return false;
+
+        if (header.pixelFormat.fourCC == fourCC("DXT1"))
+            image.format = BC1;
+        else if (header.pixelFormat.fourCC == fourCC("DXT5"))
+            image.format = BC3;
+        else if (header.pixelFormat.fourCC == fourCC("ATI1"))
+            image.format = BC4;
+        else if (header.pixelFormat.fourCC == fourCC("ATI2"))
+            image.format = BC5;
+        else
+            return false;
+        image.glFormat = glFormat(image.format);
+        image.file = file;
+        return true;
+    }
+
+    // the mip chain of one image starting at offset, which ends up right behind it
+    static bool readLevels(const DdsHeader &header, size_t &offset, CompressedImage &image)
+    {
+        const MappedFile &file = *image.file;
+        int width = header.width, height = header.height;
+        unsigned int levelCount = std::max(1u, header.mipMapCount);
+        image.levels.clear();
+        for (unsigned int i = 0; i < levelCount; i++)
+        {
+            CompressedLevel level;
+            level.width = width;
+            level.height = height;
+            level.size = BlockEncoder::levelBytes(image.format, width, height);
+            if (offset > file.size() || level.size > file.size() - offset)
+                return false;
+            level.data = file.data() + offset;
+            image.levels.push_back(level);
+
+            offset += level.size;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return true;
+    }
+
+    static bool writeFaces(const std::string &path, BlockFormat format, int width, int height,
+                           const std::vector<std::vector<std::vector<unsigned char>>> &faces)
+    {
+        DdsHeader header;
+        memset(&header, 0, sizeof(header));
+        header.size = sizeof(DdsHeader);
+        header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+        header.height = height;
+        header.width = width;
+        header.pitchOrLinearSize = (uint32_t)BlockEncoder::levelBytes(format, width, height);
+        header.mipMapCount = (uint32_t)faces[0].size();
+        header.pixelFormat.size = sizeof(DdsPixelFormat);
+        header.pixelFormat.flags = DDPF_FOURCC;
+        header.pixelFormat.fourCC = fourCC(format == BC1 ? "DXT1" : format == BC3 ? "DXT5" : format == BC4 ? "ATI1" : "ATI2");
+        header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+        if (faces.size() == 6)
+            header.caps2 = DDSCAPS2_CUBEMAP_ALLFACES;
+
+        // same as the mesh cache: never leave a half written file where the loader would pick it up
+        std::string tmpPath = path + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write("DDS ", 4);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const std::vector<std::vector<unsigned char>> &levels : faces)
+            for (const std::vector<unsigned char> &level : levels)
+                out.write(reinterpret_cast<const char*>(level.data()), level.size());
+        out.close();
+        if (!out)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    static uint32_t fourCC(const char *code)
+    {
+        return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+    }
+};
+
+#endif
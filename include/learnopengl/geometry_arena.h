@@ -0,0 +1,323 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// free space of a buffer as a list of ranges sorted by offset, handed out first fit. Freed ranges merge with the
+// free neighbours they touch.
+class RangeAllocator
+{
+public:
+    static const size_t NONE = SIZE_MAX;
+
+    explicit RangeAllocator(size_t capacity = 0)
+    {
+        reset(capacity, 0);
+    }
+
+    // everything below used is taken, the rest up to capacity free
+    void reset(size_t capacity, size_t used)
+    {
+        this->capacity = capacity;
+        freeRanges.clear();
+        if (used < capacity)
+            freeRanges.push_back(Range{ used, capacity - used });
+    }
+
+    // offset of size free units starting at a multiple of alignment, NONE if no free range holds them
+    size_t allocate(size_t size, size_t alignment = 1)
+    {
+        if (size == 0)
+            return 0;
+        for (std::vector<Range>::iterator range = freeRanges.begin(); range != freeRanges.end(); ++range)
+        {
+            size_t offset = (range->offset + alignment - 1) / alignment * alignment;
+            size_t end = range->offset + range->size;
+            if (offset > end || size > end - offset)
+                continue;
+            Range before{ range->offset, offset - range->offset };
+            Range after{ offset + size, end - offset - size };
+            range = freeRanges.erase(range);
+            if (after.size > 0)
+                range = freeRanges.insert(range, after);
+            if (before.size > 0)
+                freeRanges.insert(range, before);
+            return offset;
+        }
+        return NONE;
+    }
+
+    void free(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        std::vector<Range>::iterator next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+            [](const Range &range, size_t offset) { return range.offset < offset; });
+        next = freeRanges.insert(next, Range{ offset, size });
+        // merge with the following range, then the previous one
+        if (next + 1 != freeRanges.end() && next->offset + next->size == (next + 1)->offset)
+        {
+            next->size += (next + 1)->size;
+            freeRanges.erase(next + 1);
+        }
+        if (next != freeRanges.begin() && (next - 1)->offset + (next - 1)->size == next->offset)
+        {
+            (next - 1)->size += next->size;
+            freeRanges.erase(next);
+        }
+    }
+
+    size_t size() const
+    {
+        return capacity;
+    }
+
+    size_t freeSize() const
+    {
+        size_t total = 0;
+        for (const Range &range : freeRanges)
+            total += range.size;
+        return total;
+    }
+
+    size_t largestFree() const
+    {
+        size_t largest = 0;
+        for (const Range &range : freeRanges)
+            largest = std::max(largest, range.size);
+        return largest;
+    }
+
+private:
+    struct Range {
+        size_t offset;
+        size_t size;
+    };
+
+    size_t capacity = 0;
+    std::vector<Range> freeRanges;
+};
+
+// where one allocation's data sits in the arena's buffers
+struct GeometryRange {
+    size_t firstVertex = 0;
+    size_t vertexCount = 0;
+    // in bytes, indices of either width go into the same buffer
+    size_t indexOffset = 0;
+    size_t indexBytes = 0;
+    bool   live = false;
+};
+
+// One vertex and one index buffer shared by every mesh with vertex format V, behind a single VAO. Ranges that don't
+// fit make it compact the live ones into fresh buffers on the GPU. GL thread only.
+template<typename V>
+class GeometryArena
+{
+public:
+    static const unsigned int NONE = ~0u;
+    static const size_t INITIAL_VERTICES = 1 << 16;
+    static const size_t INITIAL_INDEX_BYTES = 1 << 20;
+
+    static GeometryArena &instance()
+    {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena &operator=(const GeometryArena&) = delete;
+
+    // copies vertexCount vertices and indexBytes of indices into the arena, returns the allocation's handle
+    unsigned int allocate(const V *vertices, size_t vertexCount, const void *indices, size_t indexBytes)
+    {
+        if (VAO == 0)
+            relocate(INITIAL_VERTICES, INITIAL_INDEX_BYTES);
+
+        GeometryRange range;
+        if (!reserve(vertexCount, indexBytes, range))
+        {
+            // compacted, the free space is one range at the end
+            if (vertexSpace.freeSize() >= vertexCount && indexSpace.freeSize() >= alignedIndexBytes(indexBytes))
+            {
+                relocate(vertexSpace.size(), indexSpace.size());
+                defragmentations++;
+            }
+            else
+            {
+                relocate(std::max(vertexSpace.size() * 2, vertexSpace.size() - vertexSpace.freeSize() + vertexCount),
+                         std::max(indexSpace.size() * 2, indexSpace.size() - indexSpace.freeSize() + alignedIndexBytes(indexBytes)));
+                grows++;
+            }
+            reserve(vertexCount, indexBytes, range);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstVertex * sizeof(V), vertexCount * sizeof(V), vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, indexBytes, indices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        unsigned int allocation;
+        if (!freeHandles.empty())
+        {
+            allocation = freeHandles.back();
+            freeHandles.pop_back();
+            ranges[allocation] = range;
+        }
+        else
+        {
+            allocation = (unsigned int)ranges.size();
+            ranges.push_back(range);
+        }
+        return allocation;
+    }
+
+    // gives the ranges back, the handle may be handed out again
+    void release(unsigned int allocation)
+    {
+        if (allocation >= ranges.size() || !ranges[allocation].live)
+            return;
+        GeometryRange &range = ranges[allocation];
+        vertexSpace.free(range.firstVertex, range.vertexCount);
+        indexSpace.free(range.indexOffset, alignedIndexBytes(range.indexBytes));
+        range.live = false;
+        freeHandles.push_back(allocation);
+    }
+
+    const GeometryRange &range(unsigned int allocation) const
+    {
+        return ranges[allocation];
+    }
+
+    // binds the shared VAO, with the attributes in enabledLocations (a bit per location) enabled. Meshes of this format
+    // draw from it until something else is bound.
+    void bind(unsigned int enabledLocations)
+    {
+        glBindVertexArray(VAO);
+        if (enabledLocations != enabledAttributes)
+        {
+            // glVertexAttribPointer reads whatever is bound to GL_ARRAY_BUFFER
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            setVertexAttributes<V>(enabledLocations);
+            enabledAttributes = enabledLocations;
+        }
+    }
+
+    // closes the gaps released allocations left, into buffers of the same size
+    void defragment()
+    {
+        if (VAO == 0)
+            return;
+        relocate(vertexSpace.size(), indexSpace.size());
+        defragmentations++;
+    }
+
+    void printReport() const
+    {
+        size_t live = ranges.size() - freeHandles.size();
+        size_t vertexBytes = (vertexSpace.size() - vertexSpace.freeSize()) * sizeof(V);
+        size_t indexBytes = indexSpace.size() - indexSpace.freeSize();
+        std::cout << "GEOMETRY_ARENA:: " << live << " meshes, vertices " << vertexBytes / 1024 << " of "
+                  << vertexSpace.size() * sizeof(V) / 1024 << " KiB, indices " << indexBytes / 1024 << " of "
+                  << indexSpace.size() / 1024 << " KiB, " << grows << " grows, " << defragmentations << " defragmentations"
+                  << std::endl;
+    }
+
+private:
+    // 32 bit indices have to start at a multiple of 4
+    static const size_t INDEX_ALIGNMENT = 4;
+
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int enabledAttributes = ~0u;
+    RangeAllocator vertexSpace, indexSpace;
+    std::vector<GeometryRange> ranges;
+    std::vector<unsigned int> freeHandles;
+    unsigned int grows = 0, defragmentations = 0;
+
+    GeometryArena()
+    {
+    }
+
+    static size_t alignedIndexBytes(size_t bytes)
+    {
+        return (bytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+    }
+
+    // finds room for both ranges, or takes neither
+    bool reserve(size_t vertexCount, size_t indexBytes, GeometryRange &range)
+    {
+        size_t firstVertex = vertexSpace.allocate(vertexCount);
+        if (firstVertex == RangeAllocator::NONE)
+            return false;
+        size_t indexOffset = indexSpace.allocate(alignedIndexBytes(indexBytes), INDEX_ALIGNMENT);
+        if (indexOffset == RangeAllocator::NONE)
+        {
+            vertexSpace.free(firstVertex, vertexCount);
+            return false;
+        }
+        range.firstVertex = firstVertex;
+        range.vertexCount = vertexCount;
+        range.indexOffset = indexOffset;
+        range.indexBytes = indexBytes;
+        range.live = true;
+        return true;
+    }
+
+    // moves every live range, packed tightly, into new buffers of the given capacities and points the VAO at them
+    void relocate(size_t vertexCapacity, size_t indexCapacity)
+    {
+        unsigned int vertexBuffer, indexBuffer;
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * sizeof(V), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+
+        size_t vertexEnd = 0, indexEnd = 0;
+        for (GeometryRange &range : ranges)
+        {
+            if (!range.live)
+                continue;
+            glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.firstVertex * sizeof(V), vertexEnd * sizeof(V),
+                                range.vertexCount * sizeof(V));
+            glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.indexOffset, indexEnd, range.indexBytes);
+            range.firstVertex = vertexEnd;
+            range.indexOffset = indexEnd;
+            vertexEnd += range.vertexCount;
+            indexEnd += alignedIndexBytes(range.indexBytes);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (VBO != 0)
+        {
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+        VBO = vertexBuffer;
+        EBO = indexBuffer;
+        vertexSpace.reset(vertexCapacity, vertexEnd);
+        indexSpace.reset(indexCapacity, indexEnd);
+
+        if (VAO == 0)
+            glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        setVertexAttributes<V>(enabledAttributes);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+    }
+};
+
+#endif
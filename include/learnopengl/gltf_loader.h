@@ -0,0 +1,585 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/json.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Imports .gltf files without ASSIMP, reading the accessors straight from the mapped .bin buffers. What it doesn't
+// support (sparse accessors, .glb) fails and goes to ASSIMP, like everything with LOGL_NO_NATIVE_GLTF=1.
+class GltfLoader
+{
+public:
+    static bool handles(const std::string &path)
+    {
+        return path.size() > 5 && path.compare(path.size() - 5, 5, ".gltf") == 0 && !getenv("LOGL_NO_NATIVE_GLTF");
+    }
+
+    static bool import(const std::string &path, ModelData &data)
+    {
+        Document document;
+        document.directory = path.substr(0, path.find_last_of('/'));
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        std::string error;
+        if (!file || !JsonValue::parse((const char*)file->data(), file->size(), document.json, error))
+        {
+            std::cout << "ERROR::GLTF:: can't parse " << path << (file ? ": " + error : std::string()) << std::endl;
+            return false;
+        }
+        const JsonValue &json = document.json;
+        if (json["asset"]["version"].string().compare(0, 1, "2") != 0)
+        {
+            std::cout << "ERROR::GLTF:: " << path << " is not glTF 2.0" << std::endl;
+            return false;
+        }
+        if (!loadBuffers(document))
+            return false;
+
+        data.directory = document.directory;
+        document.visited.assign(json["nodes"].size(), false);
+        document.meshRanges.assign(json["meshes"].size(), MeshRange());
+        const JsonValue &scene = json["scenes"][unsignedOf(json["scene"], 0)];
+        if (scene.isObject())
+        {
+            for (size_t i = 0; i < scene["nodes"].size(); i++)
+                if (!processNode(document, unsignedOf(scene["nodes"][i]), glm::mat4(1.0f), data))
+                    return false;
+        }
+        else
+        {
+            // no scene: every node that isn't a child is a root
+            std::vector<bool> child(json["nodes"].size(), false);
+            for (size_t i = 0; i < json["nodes"].size(); i++)
+                for (size_t j = 0; j < json["nodes"][i]["children"].size(); j++)
+                {
+                    size_t index = unsignedOf(json["nodes"][i]["children"][j]);
+                    if (index < child.size())
+                        child[index] = true;
+                }
+            for (size_t i = 0; i < child.size(); i++)
+                if (!child[i] && !processNode(document, i, glm::mat4(1.0f), data))
+                    return false;
+        }
+        return true;
+    }
+
+private:
+    struct Buffer {
+        std::shared_ptr<MappedFile> file;
+        // contents of a data: uri
+        std::string decoded;
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+    };
+
+    // the MeshData a glTF mesh turned into, one per (triangle) primitive
+    struct MeshRange {
+        bool imported = false;
+        size_t first = 0;
+        size_t count = 0;
+    };
+
+    struct Document {
+        JsonValue json;
+        std::string directory;
+        std::vector<Buffer> buffers;
+        std::vector<bool> visited;
+        std::vector<MeshRange> meshRanges;
+    };
+
+    // elements of one accessor, validated to lie within its buffer
+    struct Accessor {
+        const unsigned char *data = nullptr;  // nullptr: all zero (no bufferView)
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        unsigned int components = 0;
+        bool normalized = false;
+    };
+
+    enum ComponentType { BYTE = 5120, UNSIGNED_BYTE = 5121, SHORT = 5122, UNSIGNED_SHORT = 5123, UNSIGNED_INT = 5125, FLOAT = 5126 };
+    enum Mode { POINTS = 0, LINES = 1, LINE_LOOP = 2, LINE_STRIP = 3, TRIANGLES = 4, TRIANGLE_STRIP = 5, TRIANGLE_FAN = 6 };
+
+    static bool loadBuffers(Document &document)
+    {
+        const JsonValue &buffers = document.json["buffers"];
+        document.buffers.resize(buffers.size());
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            Buffer &buffer = document.buffers[i];
+            const std::string &uri = buffers[i]["uri"].string();
+            size_t byteLength = unsignedOf(buffers[i]["byteLength"], 0);
+            if (uri.compare(0, 5, "data:") == 0)
+            {
+                size_t comma = uri.find(',');
+                if (comma == std::string::npos || comma < 12 || uri.compare(comma - 7, 7, ";base64") != 0 || !decodeBase64(uri.substr(comma + 1), buffer.decoded))
+                {
+                    std::cout << "ERROR::GLTF:: buffer " << i << " has an unsupported data uri" << std::endl;
+                    return false;
+                }
+                buffer.data = (const unsigned char*)buffer.decoded.data();
+                buffer.size = buffer.decoded.size();
+            }
+            else if (!uri.empty())
+            {
+                buffer.file = Assets::open(document.directory + '/' + decodeUri(uri));
+                if (!buffer.file)
+                {
+                    std::cout << "ERROR::GLTF:: can't open buffer " << document.directory << '/' << uri << std::endl;
+                    return false;
+                }
+                buffer.data = buffer.file->data();
+                buffer.size = buffer.file->size();
+            }
+            else
+            {
+                std::cout << "ERROR::GLTF:: buffer " << i << " has no uri (binary glTF isn't supported)" << std::endl;
+                return false;
+            }
+            if (buffer.size < byteLength)
+            {
+                std::cout << "ERROR::GLTF:: buffer " << i << " is shorter than its byteLength" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // depth first, meshes of a node before its children, like Model::processNode walks ASSIMP's node tree
+    static bool processNode(Document &document, size_t index, const glm::mat4 &parentTransform, ModelData &data)
+    {
+        if (index >= document.visited.size() || document.visited[index])
+        {
+            std::cout << "ERROR::GLTF:: invalid node hierarchy" << std::endl;
+            return false;
+        }
+        document.visited[index] = true;
+
+        const JsonValue &node = document.json["nodes"][index];
+        glm::mat4 transform = parentTransform * localTransform(node);
+        if (node.has("mesh"))
+        {
+            size_t meshIndex = unsignedOf(node["mesh"]);
+            if (meshIndex >= document.meshRanges.size())
+            {
+                std::cout << "ERROR::GLTF:: node " << index << " references a missing mesh" << std::endl;
+                return false;
+            }
+            MeshRange &range = document.meshRanges[meshIndex];
+            if (!range.imported)
+            {
+                const JsonValue &mesh = document.json["meshes"][meshIndex];
+                range.imported = true;
+                range.first = data.meshes.size();
+                for (size_t i = 0; i < mesh["primitives"].size(); i++)
+                    if (!processPrimitive(document, mesh["primitives"][i], data))
+                        return false;
+                range.count = data.meshes.size() - range.first;
+            }
+            for (size_t i = 0; i < range.count; i++)
+                data.nodes.push_back(MeshNode{ (unsigned int)(range.first + i), transform });
+        }
+        for (size_t i = 0; i < node["children"].size(); i++)
+            if (!processNode(document, unsignedOf(node["children"][i]), transform, data))
+                return false;
+        return true;
+    }
+
+    // a node's matrix, or its translation * rotation * scale
+    static glm::mat4 localTransform(const JsonValue &node)
+    {
+        glm::mat4 transform(1.0f);
+        const JsonValue &matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            // column major, like glm
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    transform[column][row] = (float)matrix[column * 4 + row].number(column == row ? 1.0 : 0.0);
+            return transform;
+        }
+
+        const JsonValue &t = node["translation"], &r = node["rotation"], &s = node["scale"];
+        float x = (float)r[0].number(0.0), y = (float)r[1].number(0.0), z = (float)r[2].number(0.0), w = (float)r[3].number(1.0);
+        transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f) * (float)s[0].number(1.0);
+        transform[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f) * (float)s[1].number(1.0);
+        transform[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f) * (float)s[2].number(1.0);
+        transform[3] = glm::vec4((float)t[0].number(0.0), (float)t[1].number(0.0), (float)t[2].number(0.0), 1.0f);
+        return transform;
+    }
+
+    static bool processPrimitive(const Document &document, const JsonValue &primitive, ModelData &data)
+    {
+        LoadProfiler::Scope profile(data.directory, "processPrimitive");
+        size_t mode = unsignedOf(primitive["mode"], TRIANGLES);
+        if (mode != TRIANGLES && mode != TRIANGLE_STRIP && mode != TRIANGLE_FAN)
+        {
+            std::cout << "GLTF:: skipping a primitive of points or lines" << std::endl;
+            return true;
+        }
+
+        const JsonValue &attributes = primitive["attributes"];
+        Accessor positions, normals, texCoords, tangents, indexAccessor;
+        if (!accessor(document, attributes["POSITION"], 3, positions)
+            || (attributes.has("NORMAL") && !accessor(document, attributes["NORMAL"], 3, normals))
+            || (attributes.has("TEXCOORD_0") && !accessor(document, attributes["TEXCOORD_0"], 2, texCoords))
+            || (attributes.has("TANGENT") && !accessor(document, attributes["TANGENT"], 4, tangents))
+            || (primitive.has("indices") && !accessor(document, primitive["indices"], 1, indexAccessor)))
+            return false;
+        size_t vertexCount = positions.count;
+        if ((normals.components && normals.count != vertexCount) || (texCoords.components && texCoords.count != vertexCount)
+            || (tangents.components && tangents.count != vertexCount))
+        {
+            std::cout << "ERROR::GLTF:: attributes of a primitive differ in length" << std::endl;
+            return false;
+        }
+
+        data.ownedVertices.emplace_back(vertexCount);
+        data.ownedIndices.emplace_back();
+        std::vector<Vertex> &vertices = data.ownedVertices.back();
+        std::vector<unsigned int> &indices = data.ownedIndices.back();
+
+        // the vertex stream: one pass per attribute, straight from the mapping
+        float values[4];
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            Vertex &vertex = vertices[i];
+            read(positions, i, values);
+            vertex.Position = glm::vec3(values[0], values[1], values[2]);
+            vertex.Normal = glm::vec3(0.0f);
+            vertex.TexCoords = glm::vec2(0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+        if (normals.components)
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                read(normals, i, values);
+                vertices[i].Normal = glm::vec3(values[0], values[1], values[2]);
+            }
+        if (texCoords.components)
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                read(texCoords, i, values);
+                vertices[i].TexCoords = glm::vec2(values[0], values[1]);
+            }
+        // the bitangent's handedness is in w, as ASSIMP's glTF importer reads it
+        if (tangents.components && normals.components)
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                read(tangents, i, values);
+                vertices[i].Tangent = glm::vec3(values[0], values[1], values[2]);
+                vertices[i].Bitangent = glm::cross(vertices[i].Normal, vertices[i].Tangent) * values[3];
+            }
+
+        // triangle lists as they are, strips and fans unrolled
+        size_t count = indexAccessor.components ? indexAccessor.count : vertexCount;
+        std::vector<unsigned int> elements(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            elements[i] = indexAccessor.components ? readIndex(indexAccessor, i) : (unsigned int)i;
+            if (elements[i] >= vertexCount)
+            {
+                std::cout << "ERROR::GLTF:: index out of range" << std::endl;
+                return false;
+            }
+        }
+        if (mode == TRIANGLES)
+        {
+            indices.assign(elements.begin(), elements.begin() + count / 3 * 3);
+        }
+        else
+        {
+            for (size_t i = 0; i + 2 < count; i++)
+            {
+                if (mode == TRIANGLE_STRIP)
+                {
+                    // every other triangle flips to keep the winding
+                    indices.push_back(elements[i]);
+                    indices.push_back(elements[i + 1 + i % 2]);
+                    indices.push_back(elements[i + 2 - i % 2]);
+                }
+                else
+                {
+                    indices.push_back(elements[i + 1]);
+                    indices.push_back(elements[i + 2]);
+                    indices.push_back(elements[0]);
+                }
+            }
+        }
+
+        if (!normals.components)
+            generateNormals(vertices, indices);
+        if (texCoords.components && !(tangents.components && normals.components))
+            generateTangents(vertices, indices);
+
+        MeshData meshData;
+        meshData.vertices = Span<Vertex>(vertices.data(), vertices.size());
+        meshData.indices = Span<unsigned int>(indices.data(), indices.size());
+        meshData.textures = materialTextures(document, primitive["material"]);
+        data.meshes.push_back(meshData);
+        profile.geometry(vertices.size(), indices.size());
+        return true;
+    }
+
+    // indices, offsets and counts; anything that isn't a non negative number gives fallback, which for indices is
+    // out of range of every array
+    static size_t unsignedOf(const JsonValue &value, size_t fallback = SIZE_MAX)
+    {
+        double number = value.number(-1.0);
+        return number >= 0.0 && number < 9007199254740992.0 ? (size_t)number : fallback;
+    }
+
+    static unsigned int componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case BYTE: case UNSIGNED_BYTE: return 1;
+        case SHORT: case UNSIGNED_SHORT: return 2;
+        case UNSIGNED_INT: case FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    static unsigned int componentCount(const std::string &type)
+    {
+        return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+    }
+
+    static bool accessor(const Document &document, const JsonValue &index, unsigned int components, Accessor &result)
+    {
+        const JsonValue &json = document.json["accessors"][unsignedOf(index)];
+        result.componentType = (int)unsignedOf(json["componentType"], 0);
+        result.components = componentCount(json["type"].string());
+        result.count = unsignedOf(json["count"], 0);
+        result.normalized = json["normalized"].boolean(false);
+        unsigned int size = componentSize(result.componentType);
+        if (!json.isObject() || result.components != components || size == 0)
+        {
+            std::cout << "ERROR::GLTF:: accessor " << index.number(-1) << " isn't a valid " << components << " component accessor" << std::endl;
+            return false;
+        }
+        if (json.has("sparse"))
+        {
+            std::cout << "GLTF:: sparse accessors aren't supported" << std::endl;
+            return false;
+        }
+        if (!json.has("bufferView"))
+            return true;
+
+        const JsonValue &view = document.json["bufferViews"][unsignedOf(json["bufferView"])];
+        size_t bufferIndex = unsignedOf(view["buffer"]);
+        size_t viewOffset = unsignedOf(view["byteOffset"], 0);
+        size_t viewLength = unsignedOf(view["byteLength"], 0);
+        size_t offset = unsignedOf(json["byteOffset"], 0);
+        size_t elementSize = (size_t)size * components;
+        result.stride = unsignedOf(view["byteStride"], elementSize);
+        bool inBuffer = view.isObject() && bufferIndex < document.buffers.size() && viewOffset <= document.buffers[bufferIndex].size
+                        && viewLength <= document.buffers[bufferIndex].size - viewOffset && offset <= viewLength;
+        // the last element has to end within the view
+        size_t available = inBuffer ? viewLength - offset : 0;
+        if (!inBuffer || result.stride < elementSize
+            || (result.count > 0 && (available < elementSize || (available - elementSize) / result.stride < result.count - 1)))
+        {
+            std::cout << "ERROR::GLTF:: accessor " << index.number(-1) << " reaches outside its buffer" << std::endl;
+            return false;
+        }
+        result.data = document.buffers[bufferIndex].data + viewOffset + offset;
+        return true;
+    }
+
+    // one element as floats, normalized integers mapped to [0, 1] / [-1, 1] as the spec says
+    static void read(const Accessor &accessor, size_t element, float *out)
+    {
+        if (!accessor.data)
+        {
+            for (unsigned int c = 0; c < accessor.components; c++)
+                out[c] = 0.0f;
+            return;
+        }
+        const unsigned char *source = accessor.data + element * accessor.stride;
+        if (accessor.componentType == FLOAT)
+        {
+            memcpy(out, source, accessor.components * sizeof(float));
+            return;
+        }
+        for (unsigned int c = 0; c < accessor.components; c++)
+        {
+            float value = 0.0f, scale = 1.0f;
+            switch (accessor.componentType)
+            {
+            case BYTE:           { int8_t v;   memcpy(&v, source + c, 1);     value = v; scale = 127.0f; break; }
+            case UNSIGNED_BYTE:  { uint8_t v;  memcpy(&v, source + c, 1);     value = v; scale = 255.0f; break; }
+            case SHORT:          { int16_t v;  memcpy(&v, source + c * 2, 2); value = v; scale = 32767.0f; break; }
+            case UNSIGNED_SHORT: { uint16_t v; memcpy(&v, source + c * 2, 2); value = v; scale = 65535.0f; break; }
+            case UNSIGNED_INT:   { uint32_t v; memcpy(&v, source + c * 4, 4); value = (float)v; break; }
+            }
+            out[c] = accessor.normalized ? std::max(value / scale, -1.0f) : value;
+        }
+    }
+
+    static unsigned int readIndex(const Accessor &accessor, size_t element)
+    {
+        if (!accessor.data)
+            return 0;
+        const unsigned char *source = accessor.data + element * accessor.stride;
+        switch (accessor.componentType)
+        {
+        case UNSIGNED_BYTE:  return *source;
+        case UNSIGNED_SHORT: { uint16_t v; memcpy(&v, source, 2); return v; }
+        case UNSIGNED_INT:   { uint32_t v; memcpy(&v, source, 4); return v; }
+        default:             return ~0u;  // not a valid index type, fails the range check
+        }
+    }
+
+    // area weighted average of the face normals around each vertex
+    static void generateNormals(std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const glm::vec3 &a = vertices[indices[i]].Position;
+            glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - a, vertices[indices[i + 2]].Position - a);
+            for (int corner = 0; corner < 3; corner++)
+                vertices[indices[i + corner]].Normal += normal;
+        }
+        for (Vertex &vertex : vertices)
+        {
+            float length = glm::length(vertex.Normal);
+            vertex.Normal = length > 0.0f ? vertex.Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // per triangle tangents from the texture coordinate gradients, summed per vertex and made orthogonal to the normal
+    static void generateTangents(std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    {
+        std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const Vertex &v0 = vertices[indices[i]], &v1 = vertices[indices[i + 1]], &v2 = vertices[indices[i + 2]];
+            glm::vec3 e1 = v1.Position - v0.Position, e2 = v2.Position - v0.Position;
+            glm::vec2 d1 = v1.TexCoords - v0.TexCoords, d2 = v2.TexCoords - v0.TexCoords;
+            float determinant = d1.x * d2.y - d2.x * d1.y;
+            if (std::fabs(determinant) < 1e-12f)
+                continue;
+            float r = 1.0f / determinant;
+            glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * r;
+            glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) * r;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                vertices[indices[i + corner]].Tangent += tangent;
+                bitangents[indices[i + corner]] += bitangent;
+            }
+        }
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            Vertex &vertex = vertices[i];
+            glm::vec3 tangent = vertex.Tangent - vertex.Normal * glm::dot(vertex.Normal, vertex.Tangent);
+            float length = glm::length(tangent);
+            if (length < 1e-12f)
+            {
+                // no usable gradient: any direction perpendicular to the normal
+                tangent = glm::cross(vertex.Normal, std::fabs(vertex.Normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+                length = glm::length(tangent);
+            }
+            vertex.Tangent = tangent / length;
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+            if (glm::dot(vertex.Bitangent, bitangents[i]) < 0.0f)
+                vertex.Bitangent = -vertex.Bitangent;
+        }
+    }
+
+    static std::vector<Texture> materialTextures(const Document &document, const JsonValue &materialIndex)
+    {
+        std::vector<Texture> textures;
+        const JsonValue &material = document.json["materials"][unsignedOf(materialIndex)];
+        const JsonValue &specularGlossiness = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+
+        const JsonValue &baseColor = material["pbrMetallicRoughness"]["baseColorTexture"];
+        addTexture(document, baseColor.isObject() ? baseColor : specularGlossiness["diffuseTexture"], "texture_diffuse", textures);
+        addTexture(document, specularGlossiness["specularGlossinessTexture"], "texture_specular", textures);
+        return textures;
+    }
+
+    static void addTexture(const Document &document, const JsonValue &textureInfo, const char *type, std::vector<Texture> &textures)
+    {
+        if (!textureInfo.isObject())
+            return;
+        const JsonValue &texture = document.json["textures"][unsignedOf(textureInfo["index"])];
+        const JsonValue &image = document.json["images"][unsignedOf(texture["source"])];
+        const std::string &uri = image["uri"].string();
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+        {
+            std::cout << "GLTF:: embedded images aren't supported, " << type << " left out" << std::endl;
+            return;
+        }
+        Texture result;
+        result.id = 0;
+        result.type = type;
+        result.path = decodeUri(uri);
+        textures.push_back(result);
+    }
+
+    // uris are percent encoded ("my%20texture.png")
+    static std::string decodeUri(const std::string &uri)
+    {
+        std::string path;
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            int high, low;
+            if (uri[i] == '%' && i + 2 < uri.size() && (high = hexDigit(uri[i + 1])) >= 0 && (low = hexDigit(uri[i + 2])) >= 0)
+            {
+                path += (char)(high * 16 + low);
+                i += 2;
+            }
+            else
+            {
+                path += uri[i];
+            }
+        }
+        return path;
+    }
+
+    static int hexDigit(char c)
+    {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    }
+
+    static bool decodeBase64(const std::string &text, std::string &bytes)
+    {
+        unsigned int bits = 0;
+        int bitCount = 0;
+        for (char c : text)
+        {
+            int value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 : c >= '0' && c <= '9' ? c - '0' + 52
+                      : c == '+' ? 62 : c == '/' ? 63 : c == '=' ? -2 : -1;
+            if (value == -2)
+                break;
+            if (value < 0)
+                return false;
+            bits = (bits << 6) | value;
+            bitCount += 6;
+            if (bitCount >= 8)
+            {
+                bitCount -= 8;
+                bytes += (char)((bits >> bitCount) & 0xff);
+            }
+        }
+        return true;
+    }
+};
+
+#endif
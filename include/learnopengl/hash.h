@@ -0,0 +1,55 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Not cryptographic, but cheap, stable across runs and platforms, which is all we need
+// for keying on-disk caches and spotting byte-identical assets.
+const uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV1A_PRIME        = 0x100000001b3ULL;
+
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t hashString(const std::string &str, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+    return hashBytes(str.data(), str.size(), seed);
+}
+
+// hashBytes of a NUL terminated string, constexpr so literals can be hashed by the compiler
+constexpr uint64_t hashLiteral(const char *str, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+    uint64_t hash = seed;
+    for (; *str != '\0'; str++)
+    {
+        hash ^= (unsigned char)*str;
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+// fixed width lowercase hex, handy for cache file names
+inline std::string hashToHex(uint64_t hash)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; i--)
+    {
+        hex[i] = digits[hash & 0xf];
+        hash >>= 4;
+    }
+    return hex;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef IMAGE_DECODER_H
+#define IMAGE_DECODER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/dds_file.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// pixels decoded by stb_image, waiting to be uploaded on the GL thread. Owns the pixel memory.
+// Images that have a baked block compressed variant come back as that instead, in compressed and without pixels.
+struct DecodedImage
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char *pixels = nullptr;
+    // hash of the encoded file, identifies byte-identical images stored under different paths
+    uint64_t contentHash = 0;
+    // the decode was skipped because pixels with this content hash are resident already
+    bool skipped = false;
+    CompressedImage compressed;
+
+    DecodedImage() {}
+    DecodedImage(DecodedImage &&other) { *this = std::move(other); }
+    DecodedImage &operator=(DecodedImage &&other)
+    {
+        if (this != &other)
+        {
+            release();
+            path = std::move(other.path);
+            width = other.width;
+            height = other.height;
+            components = other.components;
+            pixels = other.pixels;
+            contentHash = other.contentHash;
+            skipped = other.skipped;
+            compressed = std::move(other.compressed);
+            other.pixels = nullptr;
+        }
+        return *this;
+    }
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage &operator=(const DecodedImage&) = delete;
+    ~DecodedImage() { release(); }
+
+    bool valid() const { return pixels != nullptr || isCompressed(); }
+    bool isCompressed() const { return !compressed.levels.empty(); }
+
+    // GL format of the pixels, one channel per component. 0 for channel counts GL has no format for.
+    GLenum pixelFormat() const
+    {
+        switch (components)
+        {
+            case 1: return GL_RED;
+            case 2: return GL_RG;
+            case 3: return GL_RGB;
+            case 4: return GL_RGBA;
+            default: return 0;
+        }
+    }
+
+    void release()
+    {
+        if (pixels)
+            stbi_image_free(pixels);
+        pixels = nullptr;
+    }
+};
+
+// Decodes images on the shared thread pool. Rows are flipped per request on the worker, so don't call
+// stbi_set_flip_vertically_on_load anywhere else.
+class ImageDecoder
+{
+public:
+    // lets the caller skip decoding images whose content hash it already knows (see TextureCache)
+    typedef std::function<bool(uint64_t contentHash)> SkipPredicate;
+
+    static DecodedImage decode(const std::string &path, bool flipVertically = false, const SkipPredicate &skip = SkipPredicate())
+    {
+        LoadProfiler::Scope profile(LoadProfiler::assetOf(path), "decode");
+        DecodedImage image;
+        image.path = path;
+
+        // compressed blocks can't simply be flipped, those requests always take the source
+        if (preferCompressed() && !flipVertically && DdsFile::hasFreshVariant(path))
+        {
+            if (DdsFile::read(DdsFile::variantPath(path), image.compressed))
+            {
+                image.width = image.compressed.levels[0].width;
+                image.height = image.compressed.levels[0].height;
+                image.contentHash = Assets::contentHash(DdsFile::variantPath(path), *image.compressed.file);
+                image.skipped = skip && skip(image.contentHash);
+                if (image.skipped)
+                    image.compressed = CompressedImage();
+                return image;
+            }
+            std::cout << "ERROR::IMAGE_DECODER:: broken compressed variant of " << path << std::endl;
+        }
+
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        if (!file)
+            return image;
+        image.contentHash = Assets::contentHash(path, *file);
+        if (skip && skip(image.contentHash))
+        {
+            image.skipped = true;
+            return image;
+        }
+
+        image.pixels = stbi_load_from_memory(file->data(), (int)file->size(), &image.width, &image.height, &image.components, 0);
+        if (image.pixels && flipVertically)
+            flipRows(image);
+        return image;
+    }
+
+    static std::future<DecodedImage> decodeAsync(const std::string &path, bool flipVertically = false, const SkipPredicate &skip = SkipPredicate())
+    {
+        return ThreadPool::shared().submit([path, flipVertically, skip]() { return decode(path, flipVertically, skip); });
+    }
+
+    // starts decoding all paths at once, the results come back in the same order
+    static std::vector<std::future<DecodedImage>> decodeAllAsync(const std::vector<std::string> &paths, bool flipVertically = false,
+                                                                 const SkipPredicate &skip = SkipPredicate())
+    {
+        std::vector<std::future<DecodedImage>> images;
+        images.reserve(paths.size());
+        for (const std::string &path : paths)
+            images.push_back(decodeAsync(path, flipVertically, skip));
+        return images;
+    }
+
+    // only the GL thread knows whether the driver takes BC textures, so it has to switch this on (off by default)
+    static void setPreferCompressed(bool prefer)
+    {
+        preferCompressedFlag().store(prefer);
+    }
+
+    static bool preferCompressed()
+    {
+        return preferCompressedFlag().load();
+    }
+
+private:
+    static std::atomic<bool> &preferCompressedFlag()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static void flipRows(DecodedImage &image)
+    {
+        size_t stride = (size_t)image.width * image.components;
+        std::vector<unsigned char> row(stride);
+        unsigned char *top = image.pixels;
+        unsigned char *bottom = image.pixels + (size_t)(image.height - 1) * stride;
+        for (; top < bottom; top += stride, bottom -= stride)
+        {
+            memcpy(row.data(), top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row.data(), stride);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Minimal read-only JSON document, enough for glTF: parse() builds the tree, lookups of missing members or elements
+// give a null value instead of failing, so optional properties read as json["a"]["b"].number(default).
+class JsonValue
+{
+public:
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Null; }
+    bool isNumber() const { return kind == Number; }
+    bool isString() const { return kind == String; }
+    bool isArray() const { return kind == Array; }
+    bool isObject() const { return kind == Object; }
+
+    double number(double fallback = 0.0) const { return kind == Number ? value : fallback; }
+    bool boolean(bool fallback = false) const { return kind == Bool ? value != 0.0 : fallback; }
+    const std::string &string() const { return text; }
+
+    // elements of an array, members of an object
+    size_t size() const { return kind == Array ? elements.size() : kind == Object ? members.size() : 0; }
+
+    // any integer type, a plain 0 would otherwise be just as good a const char* as it is a size_t
+    template<typename Index, typename = typename std::enable_if<std::is_integral<Index>::value>::type>
+    const JsonValue &operator[](Index index) const
+    {
+        return kind == Array && index >= 0 && (size_t)index < elements.size() ? elements[(size_t)index] : null();
+    }
+
+    const JsonValue &operator[](const char *name) const
+    {
+        if (kind == Object)
+            for (const std::pair<std::string, JsonValue> &member : members)
+                if (member.first == name)
+                    return member.second;
+        return null();
+    }
+
+    bool has(const char *name) const
+    {
+        return !(*this)[name].isNull();
+    }
+
+    const std::vector<std::pair<std::string, JsonValue>> &objectMembers() const { return members; }
+
+    // false (with a message naming the offset) on malformed input
+    static bool parse(const char *data, size_t size, JsonValue &result, std::string &error)
+    {
+        Parser parser{ data, data, data + size, std::string() };
+        parser.skipSpace();
+        if (!parser.parseValue(result, 0))
+        {
+            error = parser.error;
+            return false;
+        }
+        parser.skipSpace();
+        if (parser.pos != parser.end)
+        {
+            error = "trailing characters at offset " + std::to_string(parser.pos - parser.begin);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Type kind = Null;
+    double value = 0.0;
+    std::string text;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    static const JsonValue &null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+
+    struct Parser {
+        const char *begin;
+        const char *pos;
+        const char *end;
+        std::string error;
+
+        // deeper than any sane document, keeps hostile input from overflowing the stack
+        static const int MAX_DEPTH = 256;
+
+        bool fail(const char *message)
+        {
+            if (error.empty())
+                error = std::string(message) + " at offset " + std::to_string(pos - begin);
+            return false;
+        }
+
+        void skipSpace()
+        {
+            while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r'))
+                pos++;
+        }
+
+        bool literal(const char *word)
+        {
+            size_t length = strlen(word);
+            if ((size_t)(end - pos) < length || memcmp(pos, word, length) != 0)
+                return fail("invalid literal");
+            pos += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue &out, int depth)
+        {
+            if (depth > MAX_DEPTH)
+                return fail("nested too deeply");
+            if (pos >= end)
+                return fail("unexpected end of input");
+            switch (*pos)
+            {
+            case '{': return parseObject(out, depth);
+            case '[': return parseArray(out, depth);
+            case '"':
+                out.kind = String;
+                return parseString(out.text);
+            case 't':
+                out.kind = Bool;
+                out.value = 1.0;
+                return literal("true");
+            case 'f':
+                out.kind = Bool;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default:
+                return parseNumber(out);
+            }
+        }
+
+        bool parseNumber(JsonValue &out)
+        {
+            // strtod would happily read past the end of a non terminated buffer, so copy the number out first
+            const char *start = pos;
+            while (pos < end && (strchr("+-.eE", *pos) || (*pos >= '0' && *pos <= '9')))
+                pos++;
+            std::string digits(start, pos);
+            char *parsedEnd = nullptr;
+            out.value = strtod(digits.c_str(), &parsedEnd);
+            if (digits.empty() || parsedEnd != digits.c_str() + digits.size())
+                return fail("invalid number");
+            out.kind = Number;
+            return true;
+        }
+
+        static int hexDigit(char c)
+        {
+            return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        }
+
+        bool parseCodeUnit(unsigned int &unit)
+        {
+            if (end - pos < 4)
+                return fail("truncated \\u escape");
+            unit = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int digit = hexDigit(*pos++);
+                if (digit < 0)
+                    return fail("invalid \\u escape");
+                unit = unit * 16 + digit;
+            }
+            return true;
+        }
+
+        static void appendUtf8(std::string &out, unsigned int codePoint)
+        {
+            if (codePoint < 0x80)
+                out += (char)codePoint;
+            else if (codePoint < 0x800)
+            {
+                out += (char)(0xc0 | (codePoint >> 6));
+                out += (char)(0x80 | (codePoint & 0x3f));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out += (char)(0xe0 | (codePoint >> 12));
+                out += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+                out += (char)(0x80 | (codePoint & 0x3f));
+            }
+            else
+            {
+                out += (char)(0xf0 | (codePoint >> 18));
+                out += (char)(0x80 | ((codePoint >> 12) & 0x3f));
+                out += (char)(0x80 | ((codePoint >> 6) & 0x3f));
+                out += (char)(0x80 | (codePoint & 0x3f));
+            }
+        }
+
+        bool parseString(std::string &out)
+        {
+            pos++;  // opening quote
+            while (pos < end && *pos != '"')
+            {
+                if (*pos != '\\')
+                {
+                    out += *pos++;
+                    continue;
+                }
+                if (++pos >= end)
+                    break;
+                char escaped = *pos++;
+                switch (escaped)
+                {
+                case '"': case '\\': case '/': out += escaped; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    unsigned int unit = 0;
+                    if (!parseCodeUnit(unit))
+                        return false;
+                    // a surrogate pair encodes one code point outside the BMP, the high half has to be followed
+                    // by the low one
+                    if (unit >= 0xd800 && unit < 0xdc00)
+                    {
+                        if (end - pos < 6 || pos[0] != '\\' || pos[1] != 'u')
+                            return fail("unpaired surrogate");
+                        pos += 2;
+                        unsigned int low = 0;
+                        if (!parseCodeUnit(low))
+                            return false;
+                        if (low < 0xdc00 || low > 0xdfff)
+                            return fail("invalid low surrogate");
+                        unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    else if (unit >= 0xdc00 && unit <= 0xdfff)
+                        return fail("unpaired surrogate");
+                    appendUtf8(out, unit);
+                    break;
+                }
+                default:
+                    return fail("invalid escape");
+                }
+            }
+            if (pos >= end)
+                return fail("unterminated string");
+            pos++;  // closing quote
+            return true;
+        }
+
+        bool parseArray(JsonValue &out, int depth)
+        {
+            out.kind = Array;
+            pos++;
+            skipSpace();
+            if (pos < end && *pos == ']')
+            {
+                pos++;
+                return true;
+            }
+            while (true)
+            {
+                out.elements.emplace_back();
+                skipSpace();
+                if (!parseValue(out.elements.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (pos < end && *pos == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if (pos < end && *pos == ']')
+                {
+                    pos++;
+                    return true;
+                }
+                return fail("expected , or ] in array");
+            }
+        }
+
+        bool parseObject(JsonValue &out, int depth)
+        {
+            out.kind = Object;
+            pos++;
+            skipSpace();
+            if (pos < end && *pos == '}')
+            {
+                pos++;
+                return true;
+            }
+            while (true)
+            {
+                skipSpace();
+                if (pos >= end || *pos != '"')
+                    return fail("expected member name");
+                out.members.emplace_back();
+                if (!parseString(out.members.back().first))
+                    return false;
+                skipSpace();
+                if (pos >= end || *pos != ':')
+                    return fail("expected : after member name");
+                pos++;
+                skipSpace();
+                if (!parseValue(out.members.back().second, depth + 1))
+                    return false;
+                skipSpace();
+                if (pos < end && *pos == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                if (pos < end && *pos == '}')
+                {
+                    pos++;
+                    return true;
+                }
+                return fail("expected , or } in object");
+            }
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef LOAD_PROFILER_H
+#define LOAD_PROFILER_H
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Wall time, bytes read and uploaded per asset and loading phase, printed by SceneLoader and written to
+// load_profile.json (LOGL_LOAD_PROFILE). Scopes nest per thread, every row includes the ones nested in it.
+class LoadProfiler
+{
+public:
+    struct Entry {
+        std::string asset;
+        std::string phase;
+        unsigned int calls = 0;
+        double ms = 0.0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesUploaded = 0;
+        uint64_t vertices = 0;
+        uint64_t indices = 0;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(const std::string &asset, const char *phase) : parent(innermost()), start(std::chrono::steady_clock::now())
+        {
+            entry.asset = asset;
+            entry.phase = phase;
+            innermost() = this;
+        }
+
+        // a phase of whatever asset the enclosing scope is about
+        explicit Scope(const char *phase) : Scope(innermost() ? innermost()->entry.asset : std::string(), phase)
+        {
+        }
+
+        ~Scope()
+        {
+            entry.calls = 1;
+            entry.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            innermost() = parent;
+            LoadProfiler::instance().record(entry);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope &operator=(const Scope&) = delete;
+
+        void uploaded(uint64_t bytes) { entry.bytesUploaded += bytes; }
+
+        void geometry(uint64_t vertices, uint64_t indices)
+        {
+            entry.vertices += vertices;
+            entry.indices += indices;
+        }
+
+    private:
+        friend class LoadProfiler;
+        Scope *parent;
+        std::chrono::steady_clock::time_point start;
+        Entry entry;
+    };
+
+    static LoadProfiler &instance()
+    {
+        static LoadProfiler profiler;
+        return profiler;
+    }
+
+    // counts bytes read for every scope open on the calling thread
+    static void bytesRead(uint64_t bytes)
+    {
+        for (Scope *scope = innermost(); scope; scope = scope->parent)
+            scope->entry.bytesRead += bytes;
+    }
+
+    // the asset a file belongs to: its directory, textures/ left out so that a model's textures count to the model
+    static std::string assetOf(const std::string &path)
+    {
+        std::string directory = path.substr(0, path.find_last_of('/'));
+        const std::string textures = "/textures";
+        if (directory.size() > textures.size() && directory.compare(directory.size() - textures.size(), textures.size(), textures) == 0)
+            directory.resize(directory.size() - textures.size());
+        return directory;
+    }
+
+    // resident set size of the process right now (the second field of /proc/self/statm), 0 where there is none
+    static uint64_t residentBytes()
+    {
+        FILE *statm = fopen("/proc/self/statm", "r");
+        if (!statm)
+            return 0;
+        unsigned long long size = 0, resident = 0;
+        int fields = fscanf(statm, "%llu %llu", &size, &resident);
+        fclose(statm);
+        return fields == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+    }
+
+    // for phases that don't fit in a scope: they span frames (streaming uploads) or threads
+    void record(const std::string &asset, const char *phase, double ms, uint64_t bytesUploaded = 0)
+    {
+        Entry entry;
+        entry.asset = asset;
+        entry.phase = phase;
+        entry.calls = 1;
+        entry.ms = ms;
+        entry.bytesUploaded = bytesUploaded;
+        record(entry);
+    }
+
+    // adds to the totals of entry's asset and phase
+    void record(const Entry &entry)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string key = entry.asset + '\n' + entry.phase;
+        auto found = index.find(key);
+        if (found == index.end())
+        {
+            index[key] = entries.size();
+            entries.push_back(entry);
+            return;
+        }
+        Entry &total = entries[found->second];
+        total.calls += entry.calls;
+        total.ms += entry.ms;
+        total.bytesRead += entry.bytesRead;
+        total.bytesUploaded += entry.bytesUploaded;
+        total.vertices += entry.vertices;
+        total.indices += entry.indices;
+    }
+
+    // slowest first
+    std::vector<Entry> sorted() const
+    {
+        std::vector<Entry> result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result = entries;
+        }
+        std::sort(result.begin(), result.end(), [](const Entry &a, const Entry &b) { return a.ms > b.ms; });
+        return result;
+    }
+
+    void printReport() const
+    {
+        std::vector<Entry> rows = sorted();
+        size_t assetWidth = 5;
+        for (const Entry &row : rows)
+            assetWidth = std::max(assetWidth, row.asset.size());
+
+        std::ostringstream table;
+        table << std::left << std::setw(assetWidth) << "asset" << "  " << std::setw(20) << "phase" << std::right
+              << std::setw(6) << "calls" << std::setw(11) << "ms" << std::setw(12) << "read KiB" << std::setw(12)
+              << "upload KiB" << std::setw(10) << "vertices" << std::setw(10) << "indices" << "\n";
+        table << std::fixed << std::setprecision(2);
+        for (const Entry &row : rows)
+            table << std::left << std::setw(assetWidth) << row.asset << "  " << std::setw(20) << row.phase << std::right
+                  << std::setw(6) << row.calls << std::setw(11) << row.ms << std::setw(12) << row.bytesRead / 1024
+                  << std::setw(12) << row.bytesUploaded / 1024 << std::setw(10) << row.vertices << std::setw(10)
+                  << row.indices << "\n";
+        std::cout << "LOAD_PROFILE::\n" << table.str() << std::flush;
+    }
+
+    bool writeJson(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+            return false;
+        std::vector<Entry> rows = sorted();
+        out << "{\n  \"entries\": [";
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            const Entry &row = rows[i];
+            out << (i > 0 ? "," : "") << "\n    { \"asset\": \"" << escape(row.asset) << "\", \"phase\": \""
+                << escape(row.phase) << "\", \"calls\": " << row.calls << ", \"ms\": " << row.ms
+                << ", \"bytesRead\": " << row.bytesRead << ", \"bytesUploaded\": " << row.bytesUploaded
+                << ", \"vertices\": " << row.vertices << ", \"indices\": " << row.indices << " }";
+        }
+        out << "\n  ]\n}\n";
+        return (bool)out;
+    }
+
+    // table on stdout, JSON next to it
+    void report() const
+    {
+        printReport();
+        const char *path = getenv("LOGL_LOAD_PROFILE");
+        std::string jsonPath = path ? path : "load_profile.json";
+        if (writeJson(jsonPath))
+            std::cout << "LOAD_PROFILE:: written to " << jsonPath << std::endl;
+        else
+            std::cout << "ERROR::LOAD_PROFILE:: could not write " << jsonPath << std::endl;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    // asset '\n' phase -> entries index
+    std::unordered_map<std::string, size_t> index;
+
+    static Scope *&innermost()
+    {
+        static thread_local Scope *scope = nullptr;
+        return scope;
+    }
+
+    static std::string escape(const std::string &text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// non-owning view over a contiguous run of elements, e.g. vertices living inside a mapped file.
+template<typename T>
+struct Span
+{
+    const T *data = nullptr;
+    size_t size = 0;
+
+    Span() {}
+    Span(const T *data, size_t size) : data(data), size(size) {}
+
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+    const T &operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+// read-only memory mapping of a whole file. The mapping lives as long as the last shared_ptr to it,
+// so spans handed out from it stay valid for as long as someone holds on to the MappedFile.
+class MappedFile
+{
+public:
+    static std::shared_ptr<MappedFile> open(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file, the descriptor is not needed anymore
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return nullptr;
+
+        return std::shared_ptr<MappedFile>(new MappedFile(data, (size_t)st.st_size));
+    }
+
+    // size bytes at offset inside file, sharing its mapping (e.g. one entry of the asset pack). The slice keeps file
+    // mapped for as long as it lives itself.
+    static std::shared_ptr<MappedFile> slice(const std::shared_ptr<MappedFile> &file, size_t offset, size_t size)
+    {
+        if (!file || offset > file->size() || size > file->size() - offset)
+            return nullptr;
+        MappedFile *slice = new MappedFile(const_cast<unsigned char*>(file->data()) + offset, size);
+        slice->mParent = file;
+        return std::shared_ptr<MappedFile>(slice);
+    }
+
+    ~MappedFile()
+    {
+        if (!mParent)
+            munmap(mData, mSize);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    const unsigned char *data() const { return static_cast<const unsigned char*>(mData); }
+    size_t size() const { return mSize; }
+
+private:
+    void *mData;
+    size_t mSize;
+    // set for slices, which don't own their memory
+    std::shared_ptr<MappedFile> mParent;
+
+    MappedFile(void *data, size_t size) : mData(data), mSize(size) {}
+};
+
+#endif
@@ -7,7 +7,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh_lod.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <vector>
 using namespace std;
@@ -27,113 +36,366 @@ struct Vertex {
 
 
 
+// the GPU side of a Vertex, with positions quantized to the mesh's bounding box
+inline PackedVertex packVertex(const Vertex &vertex, const PositionQuantization &quantization)
+{
+    PackedVertex packed;
+    packed.Position = quantization.quantize(vertex.Position);
+    packed.Normal = packOctahedral(vertex.Normal);
+    packed.TexCoords = HalfTexCoords{ packHalf(vertex.TexCoords.x), packHalf(vertex.TexCoords.y) };
+    packed.TangentFrame = packQTangent(vertex.Tangent, vertex.Bitangent, vertex.Normal);
+    return packed;
+}
+
+// a run of a mesh's triangles drawn with one call. Its indices are relative to baseVertex, so a mesh with more
+// vertices than 16 bit indices reach is still drawn with them, a few runs of nearby vertices at a time.
+struct IndexBatch {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    int          baseVertex;
+};
+
+// cuts the triangles in indices[offset, offset + count) into runs whose vertices lie within 65536 of each other and
+// appends them to batches. The vertex fetch optimization numbers vertices in the order the triangles use them, so
+// runs come out long. False if a single triangle already spans more than 16 bits.
+inline bool splitIndexRange(const unsigned int *indices, unsigned int offset, unsigned int count, vector<IndexBatch> &batches)
+{
+    const unsigned int span = 65535;
+    unsigned int begin = offset, low = 0, high = 0;
+    for (unsigned int i = offset; i + 2 < offset + count; i += 3)
+    {
+        unsigned int triangleLow = std::min(indices[i], std::min(indices[i + 1], indices[i + 2]));
+        unsigned int triangleHigh = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+        if (triangleHigh - triangleLow > span)
+            return false;
+        if (i == begin)
+        {
+            low = triangleLow;
+            high = triangleHigh;
+        }
+        else if (std::max(high, triangleHigh) - std::min(low, triangleLow) > span)
+        {
+            batches.push_back(IndexBatch{ begin, i - begin, (int)low });
+            begin = i;
+            low = triangleLow;
+            high = triangleHigh;
+        }
+        else
+        {
+            low = std::min(low, triangleLow);
+            high = std::max(high, triangleHigh);
+        }
+    }
+    batches.push_back(IndexBatch{ begin, offset + count - begin, (int)low });
+    return true;
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// everything an import produces for one mesh, before any GL object exists. Textures only carry type and path here.
+// indices holds the triangles of every level of detail one after the other, lods says where each level is
+// (no lods means a single level made of all indices).
+struct MeshData {
+    Span<Vertex>       vertices;
+    Span<unsigned int> indices;
+    vector<Texture>    textures;
+    vector<MeshLod>    lods;
+};
+
+// one place a mesh gets drawn at: the transform of the node that references it, relative to the model.
+// A mesh several nodes reference is imported (and uploaded) once and drawn once per node.
+struct MeshNode {
+    unsigned int mesh;
+    glm::mat4    transform;
+};
+
+// result of importing a whole model. The mesh spans point either into the owned arrays below (fresh import)
+// or into a mapped mesh cache file, so they stay valid for as long as this object lives.
+struct ModelData {
+    string directory;
+    vector<MeshData> meshes;
+    vector<MeshNode> nodes;
+
+    vector<vector<Vertex>>       ownedVertices;
+    vector<vector<unsigned int>> ownedIndices;
+    shared_ptr<MappedFile>       mapping;
+};
+
+// what a Mesh keeps in RAM once its buffers are uploaded
+enum MeshResidency
+{
+    MESH_GPU_ONLY,      // textures and index ranges only, the geometry lives on the GPU alone
+    MESH_SHADOW,        // plus a MeshShadow, for picking and collision
+    MESH_CPU_COPY       // plus every vertex and index, the way meshes used to be kept
+};
+
+// compact CPU side copy of a mesh's geometry: positions and the full detail triangles
+struct MeshShadow {
+    vector<glm::vec3>    positions;
+    vector<unsigned int> indices;
+
+    size_t bytes() const
+    {
+        return positions.size() * sizeof(glm::vec3) + indices.size() * sizeof(unsigned int);
+    }
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, vertices and indices only with MESH_CPU_COPY
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // with MESH_SHADOW
+    MeshShadow           shadow;
 
-    unsigned int VAO;
+    // the mesh's vertices and indices in the GeometryArena<PackedVertex>
+    unsigned int allocation = GeometryArena<PackedVertex>::NONE;
+    unsigned int indexCount;
+    // GL_UNSIGNED_SHORT unless the mesh needs too many batches for 16 bit indices, then GL_UNSIGNED_INT
+    GLenum indexType = GL_UNSIGNED_INT;
+    // maps the 16 bit positions the GPU gets back to model space
+    PositionQuantization quantization;
+    // ranges of the index buffer, full resolution first
+    vector<MeshLod> lods;
     std::string glslIdentifierPrefix;
-    // constructor
+    // constructor, keeps the arrays it is given (MESH_CPU_COPY)
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        memoryStats().kept += this->vertices.size() * sizeof(Vertex) + this->indices.size() * sizeof(unsigned int);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // constructor for data that already sits in memory in its final layout (e.g. a mapped mesh cache),
+    // the GPU upload reads straight from it. What stays in RAM afterwards is up to residency.
+    Mesh(Span<Vertex> vertices, Span<unsigned int> indices, vector<Texture> textures, vector<MeshLod> lods = vector<MeshLod>(),
+         MeshResidency residency = defaultResidency())
+        : textures(std::move(textures)), lods(std::move(lods))
+    {
+        setupMesh(vertices.data, vertices.size, indices.data, indices.size);
+
+        size_t geometryBytes = vertices.size * sizeof(Vertex) + indices.size * sizeof(unsigned int);
+        if (residency == MESH_CPU_COPY)
+        {
+            this->vertices.assign(vertices.begin(), vertices.end());
+            this->indices.assign(indices.begin(), indices.end());
+            memoryStats().kept += geometryBytes;
+            return;
+        }
+        if (residency == MESH_SHADOW)
+        {
+            shadow.positions.reserve(vertices.size);
+            for (const Vertex &vertex : vertices)
+                shadow.positions.push_back(vertex.Position);
+            const unsigned int *first = indices.data + this->lods[0].indexOffset;
+            shadow.indices.assign(first, first + this->lods[0].indexCount);
+            memoryStats().kept += shadow.bytes();
+        }
+        memoryStats().dropped += geometryBytes - shadow.bytes();
+    }
+
+    // MESH_GPU_ONLY, or MESH_CPU_COPY with LOGL_KEEP_MESH_DATA=1 to compare the memory use
+    static MeshResidency defaultResidency()
+    {
+        static const MeshResidency residency = getenv("LOGL_KEEP_MESH_DATA") ? MESH_CPU_COPY : MESH_GPU_ONLY;
+        return residency;
+    }
+
+    // CPU side geometry bytes of all meshes so far: kept in RAM after the upload and not.
+    // And the GPU side index buffers, as uploaded and as they would have been with 32 bit indices throughout.
+    struct MemoryStats {
+        size_t kept = 0;
+        size_t dropped = 0;
+        size_t indexBytes = 0;
+        size_t wideIndexBytes = 0;
+    };
+
+    static MemoryStats &memoryStats()
+    {
+        static MemoryStats stats;
+        return stats;
+    }
+
+    // render the mesh, at the given level of detail (or the coarsest one it has)
+    void Draw(Shader &shader, unsigned int level = 0)
+    {
+        GeometryArena<PackedVertex>::instance().bind(shader.attributeMask);
+        DrawBound(shader, level);
+        glBindVertexArray(0);
+    }
+
+    // the same with the GeometryArena bound already, for drawing many meshes in a row. With an instanceCount the
+    // mesh is drawn that many times in one call, the caller sets up the per-instance attributes.
+    void DrawBound(Shader &shader, unsigned int level = 0, unsigned int instanceCount = 1)
+    {
+        if (allocation == GeometryArena<PackedVertex>::NONE)
+            return;
+        BindTextures(shader);
+        DrawGeometry(shader, level, instanceCount);
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // binds the mesh's textures and points the shader's samplers at them
+    void BindTextures(Shader &shader)
+    {
+        if (samplerNames.size() != textures.size() || samplerPrefix != glslIdentifierPrefix)
+            nameSamplers();
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    // draws the triangles of a level of detail, with the GeometryArena bound and the textures bound already
+    void DrawGeometry(Shader &shader, unsigned int level = 0, unsigned int instanceCount = 1)
+    {
+        if (allocation == GeometryArena<PackedVertex>::NONE)
+            return;
+        static constexpr UniformName positionOffset("positionOffset"), positionScale("positionScale");
+        shader.setVec3(positionOffset, quantization.offset);
+        shader.setVec3(positionScale, quantization.scale);
+
+        // draw mesh
+        level = std::min(level, (unsigned int)lods.size() - 1);
+        const GeometryRange &range = GeometryArena<PackedVertex>::instance().range(allocation);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        for (unsigned int i = lodBatches[level]; i < lodBatches[level + 1]; i++)
+        {
+            const IndexBatch &batch = batches[i];
+            void *offset = (void*)(range.indexOffset + batch.indexOffset * indexSize);
+            GLint baseVertex = (GLint)range.firstVertex + batch.baseVertex;
+            if (instanceCount == 1)
+                glDrawElementsBaseVertex(GL_TRIANGLES, batch.indexCount, indexType, offset, baseVertex);
+            else
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, batch.indexCount, indexType, offset, instanceCount, baseVertex);
+        }
+    }
+
+    // gives the mesh's geometry back to the GeometryArena, it draws nothing afterwards
+    void ReleaseGeometry()
+    {
+        GeometryArena<PackedVertex>::instance().release(allocation);
+        allocation = GeometryArena<PackedVertex>::NONE;
+    }
+
+private:
+    // the draw calls of every level of detail: level l is batches[lodBatches[l]] up to batches[lodBatches[l + 1]]
+    vector<IndexBatch> batches;
+    vector<unsigned int> lodBatches;
+
+    // a mesh too big for 16 bit indices is only split up to this many batches per level of detail,
+    // past that the extra draw calls cost more than the narrower indices save
+    static const unsigned int MAX_BATCHES_PER_LEVEL = 8;
+
+    // the sampler each texture goes to, hashed once rather than built as a string every draw
+    vector<UniformName> samplerNames;
+    std::string samplerPrefix;
+
+    // textures[i] is bound to the sampler <prefix><type><N>, where N counts the textures of that type from 1
+    // (texture_diffuse1, texture_diffuse2, texture_specular1, ...)
+    void nameSamplers()
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        samplerNames.clear();
+        samplerPrefix = glslIdentifierPrefix;
+        for (const Texture &texture : textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = texture.type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
+                number = std::to_string(specularNr++);
             else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
+                number = std::to_string(normalNr++);
             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                number = std::to_string(heightNr++);
+            samplerNames.push_back(UniformName(hashString(number, hashString(name, hashString(glslIdentifierPrefix)))));
         }
+    }
 
+    // 16 bit indices where they do (LOGL_WIDE_INDICES=1 keeps every mesh at 32 bit, for comparison).
+    // Fills batches and lodBatches, and the narrowed indices if that is what gets uploaded.
+    bool narrowIndices(const unsigned int *indexData, size_t vertexCount, vector<uint16_t> &narrow)
+    {
+        static const bool wide = getenv("LOGL_WIDE_INDICES") != nullptr;
+        batches.clear();
+        lodBatches.assign(1, 0);
+        bool fits = !wide;
+        for (const MeshLod &lod : lods)
+        {
+            if (fits && vertexCount > 65536)
+                fits = splitIndexRange(indexData, lod.indexOffset, lod.indexCount, batches)
+                       && batches.size() - lodBatches.back() <= MAX_BATCHES_PER_LEVEL;
+            else
+                batches.push_back(IndexBatch{ lod.indexOffset, lod.indexCount, 0 });
+            lodBatches.push_back((unsigned int)batches.size());
+        }
+        if (!fits)
+        {
+            batches.clear();
+            lodBatches.assign(1, 0);
+            for (const MeshLod &lod : lods)
+            {
+                batches.push_back(IndexBatch{ lod.indexOffset, lod.indexCount, 0 });
+                lodBatches.push_back((unsigned int)batches.size());
+            }
+            return false;
+        }
 
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        narrow.resize(indexCount);
+        for (const IndexBatch &batch : batches)
+            for (unsigned int i = batch.indexOffset; i < batch.indexOffset + batch.indexCount; i++)
+                narrow[i] = (uint16_t)(indexData[i] - batch.baseVertex);
+        return true;
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t numIndices)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        LoadProfiler::Scope profile("setupMesh");
 
-        glBindVertexArray(0);
+        indexCount = numIndices;
+        if (lods.empty())
+            lods.push_back(MeshLod{ 0, (unsigned int)numIndices, 0.0f });
+        vector<uint16_t> narrow;
+        indexType = narrowIndices(indexData, vertexCount, narrow) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        size_t indexBytes = numIndices * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int));
+        memoryStats().indexBytes += indexBytes;
+        memoryStats().wideIndexBytes += numIndices * sizeof(unsigned int);
+        profile.uploaded(vertexCount * sizeof(PackedVertex) + indexBytes);
+        profile.geometry(vertexCount, numIndices);
+
+        // the GPU gets the packed format, quantized to this mesh's bounds
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertexData[i].Position);
+            boundsMax = glm::max(boundsMax, vertexData[i].Position);
+        }
+        if (vertexCount > 0)
+            quantization = PositionQuantization::fromBounds(boundsMin, boundsMax);
+        vector<PackedVertex> packed(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            packed[i] = packVertex(vertexData[i], quantization);
+
+        // into the buffers shared by all meshes
+        allocation = GeometryArena<PackedVertex>::instance().allocate(packed.data(), packed.size(), indexType == GL_UNSIGNED_SHORT
+                                                                      ? (const void*)narrow.data() : indexData, indexBytes);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,318 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary cache of imported models in resources/cache, keyed by the source files and the import settings. Layout:
+// MeshCacheHeader, per mesh a MeshCacheRecord, texture strings, vertices, indices and MeshLods, then MeshCacheNodes.
+class MeshCache
+{
+public:
+    // bump whenever the layout of the file or the result of the import pipeline changes
+    static const uint32_t VERSION = 5;
+
+    static std::string cacheDirectory()
+    {
+        return "resources/cache";
+    }
+
+    // hash of everything the import depends on: the source file, the side files it pulls in, the import flags
+    // and which importer reads it (e.g. "gltf" or "assimp"), the two don't produce the same meshes
+    static uint64_t sourceHash(const string &path, unsigned int importFlags, const string &importer)
+    {
+        std::shared_ptr<MappedFile> file = Assets::open(path);
+        if (!file)
+            return 0;
+
+        const char *source = reinterpret_cast<const char*>(file->data());
+        uint64_t hash = hashBytes(source, file->size());
+        hash = hashBytes(&importFlags, sizeof(importFlags), hash);
+        hash = hashString(importer, hash);
+
+        string directory = path.substr(0, path.find_last_of('/'));
+        for (const string &name : sideFiles(path, source, source + file->size()))
+        {
+            // the name goes in too, so a side file that goes missing changes the hash as well
+            hash = hashString(name, hash);
+            std::shared_ptr<MappedFile> side = Assets::open(directory + '/' + name);
+            if (side)
+                hash = hashBytes(side->data(), side->size(), hash);
+        }
+        return hash;
+    }
+
+    static std::string cachePath(const string &path)
+    {
+        // named after the source path, so a stale entry gets overwritten instead of piling up next to the new one
+        return cacheDirectory() + "/" + hashToHex(hashString(path)) + ".mesh";
+    }
+
+    // maps the cache entry for path and fills data with spans into it. Returns false on a miss or a stale entry.
+    static bool load(const string &path, uint64_t expectedHash, ModelData &data)
+    {
+        shared_ptr<MappedFile> file = MappedFile::open(cachePath(path));
+        if (!file || file->size() < sizeof(MeshCacheHeader))
+            return false;
+        LoadProfiler::bytesRead(file->size());
+
+        MeshCacheHeader header;
+        memcpy(&header, file->data(), sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION
+            || header.vertexSize != sizeof(Vertex) || header.sourceHash != expectedHash)
+            return false;
+
+        vector<MeshData> meshes;
+        size_t offset = sizeof(MeshCacheHeader);
+        for (uint32_t m = 0; m < header.meshCount; m++)
+        {
+            MeshCacheRecord record;
+            if (!fits(*file, offset, sizeof(record)))
+                return false;
+            memcpy(&record, file->data() + offset, sizeof(record));
+            offset += sizeof(record);
+
+            MeshData mesh;
+            for (uint32_t t = 0; t < record.textureCount; t++)
+            {
+                Texture texture;
+                texture.id = 0;
+                if (!readString(*file, offset, texture.type) || !readString(*file, offset, texture.path))
+                    return false;
+                mesh.textures.push_back(texture);
+            }
+            offset = align(offset);
+
+            size_t vertexBytes = (size_t)record.vertexCount * sizeof(Vertex);
+            size_t indexBytes = (size_t)record.indexCount * sizeof(unsigned int);
+            size_t lodBytes = (size_t)record.lodCount * sizeof(MeshLod);
+            if (!fits(*file, offset, vertexBytes + indexBytes + lodBytes))
+                return false;
+            mesh.vertices = Span<Vertex>(reinterpret_cast<const Vertex*>(file->data() + offset), record.vertexCount);
+            offset += vertexBytes;
+            mesh.indices = Span<unsigned int>(reinterpret_cast<const unsigned int*>(file->data() + offset), record.indexCount);
+            offset += indexBytes;
+            mesh.lods.resize(record.lodCount);
+            if (lodBytes > 0)
+                memcpy(mesh.lods.data(), file->data() + offset, lodBytes);
+            offset = align(offset + lodBytes);
+
+            meshes.push_back(mesh);
+        }
+
+        vector<MeshNode> nodes;
+        for (uint32_t n = 0; n < header.nodeCount; n++)
+        {
+            MeshCacheNode record;
+            if (!fits(*file, offset, sizeof(record)))
+                return false;
+            memcpy(&record, file->data() + offset, sizeof(record));
+            offset += sizeof(record);
+            if (record.mesh >= meshes.size())
+                return false;
+            MeshNode node;
+            node.mesh = record.mesh;
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    node.transform[column][row] = record.transform[column * 4 + row];
+            nodes.push_back(node);
+        }
+
+        data.directory = path.substr(0, path.find_last_of('/'));
+        data.meshes.swap(meshes);
+        data.nodes.swap(nodes);
+        data.mapping = file;
+        return true;
+    }
+
+    static bool store(const string &path, uint64_t sourceHash, const ModelData &data)
+    {
+        mkdir("resources", 0755);
+        mkdir(cacheDirectory().c_str(), 0755);
+
+        // write to a temporary file first so a crash (or a second writer) never leaves a torn cache entry behind
+        std::string finalPath = cachePath(path);
+        std::string tmpPath = finalPath + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        MeshCacheHeader header;
+        memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version = VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceHash = sourceHash;
+        header.meshCount = (uint32_t)data.meshes.size();
+        header.nodeCount = (uint32_t)data.nodes.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        size_t offset = sizeof(header);
+        for (const MeshData &mesh : data.meshes)
+        {
+            MeshCacheRecord record;
+            record.vertexCount = (uint32_t)mesh.vertices.size;
+            record.indexCount = (uint32_t)mesh.indices.size;
+            record.textureCount = (uint32_t)mesh.textures.size();
+            record.lodCount = (uint32_t)mesh.lods.size();
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            offset += sizeof(record);
+
+            for (const Texture &texture : mesh.textures)
+            {
+                offset += writeString(out, texture.type);
+                offset += writeString(out, texture.path);
+            }
+            offset = pad(out, offset);
+
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data), mesh.vertices.size * sizeof(Vertex));
+            out.write(reinterpret_cast<const char*>(mesh.indices.data), mesh.indices.size * sizeof(unsigned int));
+            out.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+            offset = pad(out, offset + mesh.vertices.size * sizeof(Vertex) + mesh.indices.size * sizeof(unsigned int)
+                              + mesh.lods.size() * sizeof(MeshLod));
+        }
+        for (const MeshNode &node : data.nodes)
+        {
+            MeshCacheNode record;
+            record.mesh = node.mesh;
+            record.reserved = 0;
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    record.transform[column * 4 + row] = node.transform[column][row];
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        out.close();
+        if (!out)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), finalPath.c_str()) == 0;
+    }
+
+private:
+    static constexpr const char *MAGIC = "LOGLMESH";
+
+    struct MeshCacheHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint64_t sourceHash;
+        uint32_t meshCount;
+        uint32_t nodeCount;
+    };
+
+    struct MeshCacheRecord {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t lodCount;
+    };
+
+    struct MeshCacheNode {
+        uint32_t mesh;
+        uint32_t reserved;
+        float    transform[16];  // column major
+    };
+
+    static size_t align(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    static bool fits(const MappedFile &file, size_t offset, size_t size)
+    {
+        return offset <= file.size() && size <= file.size() - offset;
+    }
+
+    static bool readString(const MappedFile &file, size_t &offset, string &str)
+    {
+        uint32_t length;
+        if (!fits(file, offset, sizeof(length)))
+            return false;
+        memcpy(&length, file.data() + offset, sizeof(length));
+        offset += sizeof(length);
+        if (!fits(file, offset, length))
+            return false;
+        str.assign(reinterpret_cast<const char*>(file.data() + offset), length);
+        offset += length;
+        return true;
+    }
+
+    static size_t writeString(std::ofstream &out, const string &str)
+    {
+        uint32_t length = (uint32_t)str.size();
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(str.data(), length);
+        return sizeof(length) + length;
+    }
+
+    static size_t pad(std::ofstream &out, size_t offset)
+    {
+        static const char zeros[8] = {0};
+        size_t aligned = align(offset);
+        out.write(zeros, aligned - offset);
+        return aligned;
+    }
+
+    static bool endsWith(const string &text, const char *suffix)
+    {
+        size_t length = strlen(suffix);
+        return text.size() > length && text.compare(text.size() - length, length, suffix) == 0;
+    }
+
+    // the other files an import reads: external buffers of a .gltf file ("uri": "scene.bin", embedded data: uris
+    // are part of the file itself) and material libraries of an .obj file
+    static vector<string> sideFiles(const string &path, const char *begin, const char *end)
+    {
+        vector<string> files;
+        if (endsWith(path, ".gltf"))
+        {
+            static const char key[] = "\"uri\"";
+            for (const char *pos = begin; (pos = std::search(pos, end, key, key + sizeof(key) - 1)) != end;)
+            {
+                const char *open = std::find(std::find(pos, end, ':'), end, '"');
+                const char *close = open == end ? end : std::find(open + 1, end, '"');
+                if (close == end)
+                    break;
+                string uri(open + 1, close);
+                if (endsWith(uri, ".bin"))
+                    files.push_back(uri);
+                pos = close;
+            }
+        }
+        else if (endsWith(path, ".obj"))
+        {
+            // "mtllib <file>" lines, the rest of the line is the name like ASSIMP reads it
+            for (const char *line = begin; line < end;)
+            {
+                const char *lineEnd = std::find(line, end, '\n');
+                if (lineEnd - line > 7 && strncmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+                {
+                    const char *first = line + 7, *last = lineEnd;
+                    while (first < last && (*first == ' ' || *first == '\t'))
+                        first++;
+                    while (last > first && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+                        last--;
+                    if (first < last)
+                        files.push_back(string(first, last));
+                }
+                if (lineEnd == end)
+                    break;
+                line = lineEnd + 1;
+            }
+        }
+        return files;
+    }
+};
+
+#endif
@@ -0,0 +1,452 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// one level of detail of a mesh: a range of its index buffer. All levels share the mesh's vertices.
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // how far (in model units) the level's surface may be from the full resolution one
+    float error;
+};
+
+// Generates a mesh's levels of detail at import by quadric error edge collapse, each with half the triangles of the
+// one before. Only the indices change, seams and open borders keep their outline.
+class MeshSimplifier
+{
+public:
+    static const unsigned int MAX_LEVELS = 4;
+    // meshes with fewer triangles aren't worth a second level
+    static const unsigned int MIN_TRIANGLES = 64;
+
+    // appends the triangles of every coarser level to indices and describes all levels (the original first) in lods
+    template<typename Vertex>
+    static void buildLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<MeshLod> &lods)
+    {
+        lods.assign(1, MeshLod{ 0, (unsigned int)indices.size(), 0.0f });
+        if (indices.size() / 3 < MIN_TRIANGLES)
+            return;
+
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        std::vector<unsigned int> positionOf = positionRemap(positions);
+
+        std::vector<Quadric> quadrics(vertices.size());
+        std::vector<unsigned int> current(indices);
+        addTriangleQuadrics(positions, positionOf, current, quadrics);
+
+        float error = 0.0f;
+        for (unsigned int level = 1; level < MAX_LEVELS; level++)
+        {
+            size_t previous = current.size() / 3;
+            collapse(positions, positionOf, quadrics, current, previous / 2, error);
+            if (current.size() / 3 > previous * 85 / 100)
+                break;
+
+            std::vector<unsigned int> optimized(current);
+            MeshOptimizer::optimizeVertexCache(optimized, vertices.size());
+            lods.push_back(MeshLod{ (unsigned int)indices.size(), (unsigned int)optimized.size(), error });
+            indices.insert(indices.end(), optimized.begin(), optimized.end());
+        }
+    }
+
+private:
+    // open borders are held in place by planes through them, weighted well above the surface planes
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+    // symmetric 4x4 matrix, upper triangle: xx xy xz xw yy yz yw zz zw ww
+    struct Quadric
+    {
+        double q[10] = { 0.0 };
+
+        static Quadric plane(const glm::vec3 &normal, float distance, double weight)
+        {
+            Quadric quadric;
+            double a = normal.x, b = normal.y, c = normal.z, d = distance;
+            double values[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+            for (int i = 0; i < 10; i++)
+                quadric.q[i] = values[i] * weight;
+            return quadric;
+        }
+
+        Quadric &operator+=(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                q[i] += other.q[i];
+            return *this;
+        }
+
+        // sum of the squared distances of p to the planes
+        double evaluate(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+                 + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+                 + q[7] * z * z + 2.0 * q[8] * z + q[9];
+        }
+    };
+
+    struct Candidate
+    {
+        double cost;
+        unsigned int from, to;
+        bool operator<(const Candidate &other) const { return cost < other.cost; }
+    };
+
+    // vertex -> first vertex at exactly the same position, seams split vertices that are one point of the surface
+    static std::vector<unsigned int> positionRemap(const std::vector<glm::vec3> &positions)
+    {
+        std::vector<unsigned int> order(positions.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (unsigned int)i;
+        auto less = [&positions](unsigned int a, unsigned int b) {
+            const glm::vec3 &p = positions[a], &q = positions[b];
+            if (p.x != q.x) return p.x < q.x;
+            if (p.y != q.y) return p.y < q.y;
+            if (p.z != q.z) return p.z < q.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        std::vector<unsigned int> remap(positions.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const glm::vec3 &p = positions[order[i]];
+            bool same = i > 0 && positions[order[i - 1]].x == p.x && positions[order[i - 1]].y == p.y && positions[order[i - 1]].z == p.z;
+            remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+        }
+        return remap;
+    }
+
+    static glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        return glm::cross(b - a, c - a);
+    }
+
+    static void addTriangleQuadrics(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &positionOf,
+                                    const std::vector<unsigned int> &indices, std::vector<Quadric> &quadrics)
+    {
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            unsigned int p[3] = { positionOf[indices[t]], positionOf[indices[t + 1]], positionOf[indices[t + 2]] };
+            glm::vec3 normal = triangleNormal(positions[p[0]], positions[p[1]], positions[p[2]]);
+            float length = glm::length(normal);
+            if (length == 0.0f)
+                continue;
+            normal = normal / length;
+            Quadric quadric = Quadric::plane(normal, -glm::dot(normal, positions[p[0]]), 1.0);
+            for (int k = 0; k < 3; k++)
+                quadrics[p[k]] += quadric;
+        }
+    }
+
+    // collapses edges of indices until it has at most targetTriangles triangles or nothing can go anymore. Works in
+    // passes: every pass picks the cheapest collapses that don't touch each other, then rebuilds the triangle list.
+    static void collapse(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &positionOf,
+                         std::vector<Quadric> &quadrics, std::vector<unsigned int> &indices, size_t targetTriangles, float &error)
+    {
+        size_t vertexCount = positions.size();
+        while (indices.size() / 3 > targetTriangles)
+        {
+            size_t triangleCount = indices.size() / 3;
+
+            // triangles around every position
+            std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+            for (unsigned int index : indices)
+                triangleOffsets[positionOf[index] + 1]++;
+            for (size_t v = 0; v < vertexCount; v++)
+                triangleOffsets[v + 1] += triangleOffsets[v];
+            std::vector<unsigned int> adjacent(indices.size());
+            std::vector<unsigned int> filled(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                adjacent[filled[positionOf[indices[i]]]++] = (unsigned int)(i / 3);
+
+            // every edge once per triangle using it, as (smaller, larger) position. Used once means open border.
+            std::vector<std::pair<unsigned int, unsigned int>> edges;
+            edges.reserve(indices.size());
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int a = positionOf[indices[t * 3 + k]], b = positionOf[indices[t * 3 + (k + 1) % 3]];
+                    if (a != b)
+                        edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+
+            std::vector<bool> border(vertexCount, false);
+            std::vector<std::pair<unsigned int, unsigned int>> borderEdges, uniqueEdges;
+            for (size_t i = 0; i < edges.size();)
+            {
+                size_t j = i;
+                while (j < edges.size() && edges[j] == edges[i])
+                    j++;
+                if (j - i == 1)
+                {
+                    border[edges[i].first] = border[edges[i].second] = true;
+                    borderEdges.push_back(edges[i]);
+                }
+                uniqueEdges.push_back(edges[i]);
+                i = j;
+            }
+
+            // border planes, perpendicular to the triangle along the edge. Added to copies so they don't pile up.
+            std::vector<Quadric> constrained(quadrics);
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                unsigned int p[3] = { positionOf[indices[t * 3]], positionOf[indices[t * 3 + 1]], positionOf[indices[t * 3 + 2]] };
+                glm::vec3 normal = triangleNormal(positions[p[0]], positions[p[1]], positions[p[2]]);
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int a = p[k], b = p[(k + 1) % 3];
+                    if (!border[a] || !border[b] || !std::binary_search(borderEdges.begin(), borderEdges.end(), std::make_pair(std::min(a, b), std::max(a, b))))
+                        continue;
+                    glm::vec3 edgeNormal = glm::cross(positions[b] - positions[a], normal);
+                    float length = glm::length(edgeNormal);
+                    if (length == 0.0f)
+                        continue;
+                    edgeNormal = edgeNormal / length;
+                    Quadric quadric = Quadric::plane(edgeNormal, -glm::dot(edgeNormal, positions[a]), BORDER_WEIGHT);
+                    constrained[a] += quadric;
+                    constrained[b] += quadric;
+                }
+            }
+
+            std::vector<Candidate> candidates;
+            candidates.reserve(uniqueEdges.size() * 2);
+            for (const std::pair<unsigned int, unsigned int> &edge : uniqueEdges)
+            {
+                bool borderEdge = std::binary_search(borderEdges.begin(), borderEdges.end(), edge);
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction ? edge.second : edge.first, to = direction ? edge.first : edge.second;
+                    // a border vertex may only slide along its border
+                    if (border[from] && !borderEdge)
+                        continue;
+                    Quadric quadric = constrained[from];
+                    quadric += constrained[to];
+                    candidates.push_back(Candidate{ quadric.evaluate(positions[to]), from, to });
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            std::vector<unsigned int> remap(vertexCount);
+            for (size_t v = 0; v < vertexCount; v++)
+                remap[v] = (unsigned int)v;
+            std::vector<bool> touched(vertexCount, false);
+            size_t removed = 0, collapses = 0;
+            std::vector<std::pair<unsigned int, unsigned int>> wedges;
+            for (const Candidate &candidate : candidates)
+            {
+                if (triangleCount - removed <= targetTriangles)
+                    break;
+                unsigned int from = candidate.from, to = candidate.to;
+                if (touched[from] || touched[to])
+                    continue;
+
+                wedges.clear();
+                size_t shared = 0;
+                if (!planCollapse(positions, positionOf, indices, adjacent, triangleOffsets, from, to, wedges, shared))
+                    continue;
+
+                for (const std::pair<unsigned int, unsigned int> &wedge : wedges)
+                    remap[wedge.first] = wedge.second;
+                quadrics[to] += quadrics[from];
+                // everything around from changes shape, leave it alone for the rest of the pass
+                for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+                    for (int k = 0; k < 3; k++)
+                        touched[positionOf[indices[adjacent[i] * 3 + k]]] = true;
+                touched[to] = true;
+
+                removed += shared;
+                collapses++;
+                error = std::max(error, (float)std::sqrt(std::max(candidate.cost, 0.0)));
+            }
+            if (collapses == 0)
+                return;
+
+            std::vector<unsigned int> result;
+            result.reserve(indices.size());
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                unsigned int v[3] = { remap[indices[t * 3]], remap[indices[t * 3 + 1]], remap[indices[t * 3 + 2]] };
+                unsigned int p[3] = { positionOf[v[0]], positionOf[v[1]], positionOf[v[2]] };
+                if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2])
+                    continue;
+                result.insert(result.end(), v, v + 3);
+            }
+            indices.swap(result);
+        }
+    }
+
+    // checks whether position from can move onto position to and fills wedges with where each vertex at from goes:
+    // its counterpart at to in a triangle they share. shared counts the triangles that disappear.
+    static bool planCollapse(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &positionOf,
+                             const std::vector<unsigned int> &indices, const std::vector<unsigned int> &adjacent,
+                             const std::vector<unsigned int> &triangleOffsets, unsigned int from, unsigned int to,
+                             std::vector<std::pair<unsigned int, unsigned int>> &wedges, size_t &shared)
+    {
+        for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+        {
+            const unsigned int *triangle = &indices[adjacent[i] * 3];
+            int fromCorner = -1, toCorner = -1;
+            for (int k = 0; k < 3; k++)
+            {
+                if (positionOf[triangle[k]] == from)
+                    fromCorner = k;
+                else if (positionOf[triangle[k]] == to)
+                    toCorner = k;
+            }
+            if (fromCorner < 0)
+                continue;
+
+            if (toCorner >= 0)
+            {
+                shared++;
+                unsigned int wedge = triangle[fromCorner], target = triangle[toCorner];
+                bool known = false;
+                for (const std::pair<unsigned int, unsigned int> &existing : wedges)
+                {
+                    if (existing.first == wedge)
+                    {
+                        known = true;
+                        // one vertex would have to go to two different ones, that tears the attributes apart
+                        if (existing.second != target)
+                            return false;
+                    }
+                }
+                if (!known)
+                    wedges.push_back(std::make_pair(wedge, target));
+                continue;
+            }
+
+            // the triangle stays, it must not flip over
+            glm::vec3 corners[3], moved[3];
+            for (int k = 0; k < 3; k++)
+            {
+                corners[k] = moved[k] = positions[positionOf[triangle[k]]];
+                if (k == fromCorner)
+                    moved[k] = positions[to];
+            }
+            glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+            glm::vec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+
+        // every vertex at from needs a counterpart at to, otherwise it sits across a seam from the edge
+        for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+        {
+            const unsigned int *triangle = &indices[adjacent[i] * 3];
+            for (int k = 0; k < 3; k++)
+            {
+                if (positionOf[triangle[k]] != from)
+                    continue;
+                bool found = false;
+                for (const std::pair<unsigned int, unsigned int> &wedge : wedges)
+                    found = found || wedge.first == triangle[k];
+                if (!found)
+                    return false;
+            }
+        }
+        return !wedges.empty();
+    }
+};
+
+// Picks the coarsest level whose error projects to less than LOGL_LOD_ERROR_PX pixels (default 1, 0 always draws
+// full resolution), with some hysteresis so instances at a threshold don't flip between levels.
+class LodSelector
+{
+public:
+    // a coarser level has to be this far under the pixel threshold before it is taken
+    static constexpr float HYSTERESIS = 0.7f;
+
+    static LodSelector &instance()
+    {
+        static LodSelector selector;
+        return selector;
+    }
+
+    LodSelector()
+    {
+        const char *pixels = getenv("LOGL_LOD_ERROR_PX");
+        maxErrorPixels = pixels ? (float)atof(pixels) : 1.0f;
+    }
+
+    // call once per frame with the matrices the scene is drawn with
+    void beginFrame(const glm::mat4 &projection, const glm::vec3 &cameraPosition, float viewportHeight)
+    {
+        camera = cameraPosition;
+        // pixels per unit at distance 1, the projection scales y by cot(fov / 2)
+        pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+        if (frameFull > 0)
+        {
+            frames++;
+            totalDrawn += frameDrawn;
+            totalFull += frameFull;
+        }
+        lastDrawn = frameDrawn;
+        lastFull = frameFull;
+        frameDrawn = frameFull = 0;
+    }
+
+    // the level to draw an instance with this frame. errors holds each level's error in model units, current is the
+    // level the instance was drawn with last time.
+    unsigned int select(const std::vector<float> &errors, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                        const glm::mat4 &modelMatrix, unsigned int current) const
+    {
+        if (errors.size() <= 1 || maxErrorPixels <= 0.0f)
+            return 0;
+
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+        // the nearest point of the bounding sphere, where the error would look largest
+        float distance = std::max(glm::length(center - camera) - radius, 0.1f);
+        float pixelsPerModelUnit = pixelsPerUnit * scale / distance;
+
+        unsigned int level = std::min(current, (unsigned int)errors.size() - 1);
+        while (level > 0 && errors[level] * pixelsPerModelUnit > maxErrorPixels)
+            level--;
+        while (level + 1 < errors.size() && errors[level + 1] * pixelsPerModelUnit < maxErrorPixels * HYSTERESIS)
+            level++;
+        return level;
+    }
+
+    // triangles an instance was drawn with, and what full resolution would have cost
+    void count(size_t drawn, size_t full)
+    {
+        frameDrawn += drawn;
+        frameFull += full;
+    }
+
+    void printReport() const
+    {
+        if (totalFull == 0)
+            return;
+        std::cout << "MESH_LOD:: drew " << 100.0 * totalDrawn / totalFull << "% of the full resolution triangles over "
+                  << frames << " frames, last frame " << lastDrawn << " of " << lastFull << std::endl;
+    }
+
+private:
+    float maxErrorPixels;
+    glm::vec3 camera = glm::vec3(0.0f);
+    float pixelsPerUnit = 1.0f;
+    size_t frameDrawn = 0, frameFull = 0, lastDrawn = 0, lastFull = 0;
+    size_t totalDrawn = 0, totalFull = 0, frames = 0;
+};
+
+#endif
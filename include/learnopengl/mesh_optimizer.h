@@ -0,0 +1,322 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// how well an index buffer uses the post-transform vertex cache, simulated as a FIFO of cacheSize vertices.
+//   ACMR: vertices transformed per triangle, 0.5 is about the best a regular grid gets, 3 means no reuse at all
+//   ATVR: vertices transformed per vertex of the mesh, 1 is optimal
+struct VertexCacheStatistics
+{
+    size_t triangles = 0;
+    size_t vertices = 0;
+    size_t transformed = 0;
+
+    float acmr() const { return triangles ? (float)transformed / triangles : 0.0f; }
+    float atvr() const { return vertices ? (float)transformed / vertices : 0.0f; }
+
+    VertexCacheStatistics &operator+=(const VertexCacheStatistics &other)
+    {
+        triangles += other.triangles;
+        vertices += other.vertices;
+        transformed += other.transformed;
+        return *this;
+    }
+};
+
+// Import time reordering of triangle lists for the post-transform cache (Forsyth), overdraw and vertex fetch.
+// optimize() runs all three, Vertex needs a glm::vec3 Position.
+class MeshOptimizer
+{
+public:
+    // the FIFO the statistics simulate; real hardware lies somewhere between 16 and 32 entries
+    static const unsigned int ANALYZE_CACHE_SIZE = 16;
+
+    template<typename Vertex>
+    static void optimize(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        if (indices.size() < 3 || indices.size() % 3 != 0)
+            return;
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        optimizeVertexFetch(vertices, indices);
+    }
+
+    static VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                    unsigned int cacheSize = ANALYZE_CACHE_SIZE)
+    {
+        VertexCacheStatistics statistics;
+        statistics.triangles = indices.size() / 3;
+
+        std::vector<bool> used(vertexCount, false);
+        // a vertex is in the FIFO if fewer than cacheSize misses happened since it went in
+        std::vector<size_t> insertedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (unsigned int index : indices)
+        {
+            if (!used[index])
+            {
+                used[index] = true;
+                statistics.vertices++;
+            }
+            else if (misses - insertedAt[index] < cacheSize)
+                continue;
+            insertedAt[index] = misses;
+            misses++;
+        }
+        statistics.transformed = misses;
+        return statistics;
+    }
+
+    static void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // triangles using each vertex, as one array with offsets
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+
+        // triangles of each vertex that are still to be emitted
+        std::vector<unsigned int> remaining(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            remaining[v] = offsets[v + 1] - offsets[v];
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = score(-1, remaining[v]);
+
+        std::vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> cache, nextCache;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        size_t cursor = 0;
+        int best = nextTriangle(emitted, cursor);
+        while (best >= 0)
+        {
+            emitted[best] = true;
+            nextCache.clear();
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[best * 3 + k];
+                result.push_back(v);
+                nextCache.push_back(v);
+                // the triangle isn't waiting for this vertex anymore
+                unsigned int *begin = &adjacency[offsets[v]], *end = begin + remaining[v];
+                std::swap(*std::find(begin, end, (unsigned int)best), *(end - 1));
+                remaining[v]--;
+            }
+            for (unsigned int v : cache)
+                if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                    nextCache.push_back(v);
+
+            // rescore every vertex that moved in the cache or fell out of it, and the triangles still waiting on them
+            std::vector<unsigned int> touched(nextCache);
+            for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = -1;
+            nextCache.resize(std::min(nextCache.size(), (size_t)FORSYTH_CACHE_SIZE));
+            for (size_t i = 0; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = (int)i;
+
+            for (unsigned int v : touched)
+            {
+                float updated = score(cachePosition[v], remaining[v]);
+                float delta = updated - vertexScore[v];
+                vertexScore[v] = updated;
+                for (unsigned int i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+                    triangleScore[adjacency[i]] += delta;
+            }
+
+            // the next triangle is one that uses a cached vertex, otherwise the cache is no help anyway
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : nextCache)
+            {
+                for (unsigned int i = offsets[v]; i < offsets[v] + remaining[v]; i++)
+                {
+                    if (triangleScore[adjacency[i]] > bestScore)
+                    {
+                        bestScore = triangleScore[adjacency[i]];
+                        best = (int)adjacency[i];
+                    }
+                }
+            }
+            if (best < 0)
+                best = nextTriangle(emitted, cursor);
+            cache.swap(nextCache);
+        }
+        indices.swap(result);
+    }
+
+    // indices should be in cache order already. threshold is how much worse than that the ACMR may get.
+    template<typename Vertex>
+    static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, float threshold = 1.05f)
+    {
+        size_t triangleCount = indices.size() / 3;
+        std::vector<size_t> clusters = clusterBoundaries(indices, vertices.size(), threshold);
+
+        glm::vec3 meshCentroid(0.0f);
+        for (unsigned int index : indices)
+            meshCentroid += vertices[index].Position;
+        meshCentroid /= (float)indices.size();
+
+        // clusters facing away from the centre are the outside of the mesh, draw those first
+        std::vector<std::pair<float, size_t>> order;
+        for (size_t c = 0; c + 1 < clusters.size(); c++)
+        {
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+            {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 cross = glm::cross(b - a, d - a);
+                float triangleArea = glm::length(cross);
+                centroid += (a + b + d) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+            float key = 0.0f;
+            float normalLength = glm::length(normal);
+            if (area > 0.0f && normalLength > 0.0f)
+                key = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+            order.push_back(std::make_pair(-key, c));
+        }
+        std::stable_sort(order.begin(), order.end());
+
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        for (const std::pair<float, size_t> &cluster : order)
+            result.insert(result.end(), indices.begin() + clusters[cluster.second] * 3, indices.begin() + clusters[cluster.second + 1] * 3);
+        indices.swap(result);
+    }
+
+    template<typename Vertex>
+    static void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (unsigned int)reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(reordered);
+    }
+
+private:
+    static const unsigned int FORSYTH_CACHE_SIZE = 32;
+
+    // Forsyth's vertex score: recently used vertices score high (the last triangle's three equally, so the next one
+    // doesn't have to share all of them), vertices with few triangles left get a boost so they are finished off
+    static float score(int cachePosition, unsigned int remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+
+        float result = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+                result = 0.75f;
+            else
+                result = std::pow(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        return result + 2.0f / std::sqrt((float)remaining);
+    }
+
+    // first triangle not emitted yet, the scan starts at cursor since every triangle before it is done
+    static int nextTriangle(const std::vector<bool> &emitted, size_t &cursor)
+    {
+        while (cursor < emitted.size() && emitted[cursor])
+            cursor++;
+        return cursor < emitted.size() ? (int)cursor : -1;
+    }
+
+    // splits the triangles into clusters (first triangle of each, plus the end) that can be reordered among each other.
+    // A cluster ends where the cache is cold anyway (a triangle misses all three vertices) or, in between, as soon as
+    // its ACMR is within threshold of what the whole run between two cold spots achieves.
+    static std::vector<size_t> clusterBoundaries(const std::vector<unsigned int> &indices, size_t vertexCount, float threshold)
+    {
+        size_t triangleCount = indices.size() / 3;
+        std::vector<size_t> insertedAt(vertexCount, 0);
+        size_t misses = ANALYZE_CACHE_SIZE;  // so that nothing starts out cached
+        auto transform = [&](size_t t) {
+            unsigned int count = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if (misses - insertedAt[v] >= ANALYZE_CACHE_SIZE)
+                {
+                    insertedAt[v] = misses++;
+                    count++;
+                }
+            }
+            return count;
+        };
+
+        std::vector<size_t> hard;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            unsigned int missed = transform(t);
+            if (t == 0 || missed == 3)
+                hard.push_back(t);
+        }
+        hard.push_back(triangleCount);
+
+        std::vector<size_t> boundaries;
+        for (size_t h = 0; h + 1 < hard.size(); h++)
+        {
+            size_t start = hard[h], end = hard[h + 1];
+
+            misses += ANALYZE_CACHE_SIZE;
+            size_t runMisses = 0;
+            for (size_t t = start; t < end; t++)
+                runMisses += transform(t);
+            float limit = threshold * runMisses / (end - start);
+
+            misses += ANALYZE_CACHE_SIZE;
+            size_t clusterStart = start, clusterMisses = 0;
+            boundaries.push_back(start);
+            for (size_t t = start; t < end; t++)
+            {
+                clusterMisses += transform(t);
+                if (t + 1 < end && clusterMisses <= limit * (t + 1 - clusterStart))
+                {
+                    // the next cluster may well be drawn after a different one, it starts cold
+                    misses += ANALYZE_CACHE_SIZE;
+                    boundaries.push_back(t + 1);
+                    clusterStart = t + 1;
+                    clusterMisses = 0;
+                }
+            }
+        }
+        boundaries.push_back(triangleCount);
+        return boundaries;
+    }
+};
+
+#endif
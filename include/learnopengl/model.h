@@ -10,94 +10,614 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/asset_io.h>
+#include <learnopengl/gltf_loader.h>
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/load_profiler.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
 
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
-
-
 class Model
 {
 public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    // where the meshes get drawn; a mesh several nodes reference is drawn once per node. No nodes: every mesh once, untransformed.
+    vector<MeshNode> nodes;
     string directory;
     bool gammaCorrection;
+    // model space bounding box of all meshes added so far, placed by their nodes, empty (min > max) while there are none
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    // error of each level of detail, the largest any mesh has at that level
+    vector<float> lodErrors;
+    // what the meshes keep in RAM after uploading, MESH_SHADOW for models that get picked or collided with
+    MeshResidency residency;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, MeshResidency residency = Mesh::defaultResidency())
+        : gammaCorrection(gamma), residency(residency)
     {
         loadModel(path);
     }
 
+    // empty model, to be filled in piece by piece (see SceneLoader). Draws nothing until its first mesh is added.
+    explicit Model(bool gamma = false, MeshResidency residency = Mesh::defaultResidency())
+        : gammaCorrection(gamma), residency(residency)
+    {
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        GeometryArena<PackedVertex>::instance().bind(shader.attributeMask);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].DrawBound(shader);
+        glBindVertexArray(0);
+    }
+
+    // draws the model at the level of detail the LodSelector picks for modelMatrix. A model drawn several times a
+    // frame numbers its instances, each keeps its own level from frame to frame. Nodes with a transform of their own
+    // set the shader's "model" matrix to modelMatrix * transform.
+    void Draw(Shader &shader, const glm::mat4 &modelMatrix, unsigned int instance = 0)
+    {
+        if (instance >= instanceLods.size())
+            instanceLods.resize(instance + 1, 0);
+        unsigned int &level = instanceLods[instance];
+        level = LodSelector::instance().select(lodErrors, boundsMin, boundsMax, modelMatrix, level);
+
+        // every mesh draws from the one VAO of the GeometryArena
+        GeometryArena<PackedVertex>::instance().bind(shader.attributeMask);
+        drawLevel(shader, modelMatrix, level, 1);
+        glBindVertexArray(0);
+    }
+
+    // queues the model for drawing at modelMatrix instead of drawing it right away: a packet per mesh, placed by its
+    // node, at the level of detail Draw would pick. See RenderQueue.
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &modelMatrix, unsigned int instance = 0)
+    {
+        if (instance >= instanceLods.size())
+            instanceLods.resize(instance + 1, 0);
+        unsigned int &level = instanceLods[instance];
+        level = LodSelector::instance().select(lodErrors, boundsMin, boundsMax, modelMatrix, level);
+
+        size_t drawn = 0, full = 0;
+        auto submit = [&](Mesh &mesh, const glm::mat4 &transform) {
+            queue.submit(shader, mesh, level, transform);
+            drawn += mesh.lods[std::min(level, (unsigned int)mesh.lods.size() - 1)].indexCount / 3;
+            full += mesh.lods[0].indexCount / 3;
+        };
+        if (nodes.empty())
+        {
+            for (Mesh &mesh : meshes)
+                submit(mesh, modelMatrix);
+        }
+        else
+        {
+            for (const MeshNode &node : nodes)
+                if (node.mesh < meshes.size())
+                    submit(meshes[node.mesh], modelMatrix * node.transform);
+        }
+        LodSelector::instance().count(drawn, full);
+    }
+
+    // draws the model once for every matrix in modelMatrices, with one glDrawElementsInstanced per mesh and level of
+    // detail. Every instance gets its own level like with Draw (instances are numbered by their place in
+    // modelMatrices), instances at the same level are drawn together. The matrices reach the shader through the
+    // model's instance buffer as aInstanceModel, the "model" uniform carries the node transforms and is left at the
+    // identity.
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &modelMatrices)
+    {
+        if (modelMatrices.empty())
+            return;
+        if (modelMatrices.size() > instanceLods.size())
+            instanceLods.resize(modelMatrices.size(), 0);
+
+        // group the instances by level, in one buffer
+        unsigned int levels = std::max((unsigned int)lodErrors.size(), 1u);
+        vector<unsigned int> firstOfLevel(levels + 1, 0);
+        for (unsigned int i = 0; i < modelMatrices.size(); i++)
+        {
+            instanceLods[i] = LodSelector::instance().select(lodErrors, boundsMin, boundsMax, modelMatrices[i], instanceLods[i]);
+            firstOfLevel[instanceLods[i] + 1]++;
+        }
+        for (unsigned int level = 0; level < levels; level++)
+            firstOfLevel[level + 1] += firstOfLevel[level];
+        instanceMatrices.resize(modelMatrices.size());
+        vector<unsigned int> next(firstOfLevel.begin(), firstOfLevel.end() - 1);
+        for (unsigned int i = 0; i < modelMatrices.size(); i++)
+            instanceMatrices[next[instanceLods[i]]++] = modelMatrices[i];
+
+        // uploaded only when the instances or their levels changed, the buffer is only reallocated to grow
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instanceMatrices.size() > instanceCapacity)
+        {
+            instanceCapacity = std::max(instanceMatrices.size(), instanceCapacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+            uploadedMatrices.clear();
+        }
+        if (instanceMatrices != uploadedMatrices)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instanceMatrices.size() * sizeof(glm::mat4), instanceMatrices.data());
+            uploadedMatrices = instanceMatrices;
+        }
+
+        static constexpr UniformName instanced("instanced"), model("model");
+        shader.setBool(instanced, true);
+        shader.setMat4(model, glm::mat4(1.0f));
+        GeometryArena<PackedVertex>::instance().bind(shader.attributeMask);
+        for (unsigned int level = 0; level < levels; level++)
+        {
+            unsigned int count = firstOfLevel[level + 1] - firstOfLevel[level];
+            if (count == 0)
+                continue;
+            // a mat4 attribute takes four locations, a column each
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            for (unsigned int column = 0; column < 4; column++)
+            {
+                GLuint location = INSTANCE_MODEL_LOCATION + column;
+                size_t offset = firstOfLevel[level] * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+                glVertexAttribDivisor(location, 1);
+                glEnableVertexAttribArray(location);
+            }
+            drawLevel(shader, glm::mat4(1.0f), level, count);
+        }
+        // the VAO is shared with every other mesh, which doesn't read them
+        for (unsigned int column = 0; column < 4; column++)
+            glDisableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+        glBindVertexArray(0);
+        shader.setBool(instanced, false);
+    }
+
+    // tells the TextureResidency the model gets drawn with modelMatrix this frame, call it next to Draw
+    void UseTextures(const glm::mat4 &modelMatrix)
+    {
+        TextureResidency::instance().use(meshes, boundsMin, boundsMax, modelMatrix);
+    }
+
+    // the same for all instances of DrawInstanced at once, as one box around all of them
+    void UseTextures(const vector<glm::mat4> &modelMatrices)
+    {
+        if (modelMatrices.empty() || boundsMin.x > boundsMax.x)
+            return;
+        if (modelMatrices != instanceBoundsMatrices || boundsMin != instanceBoundsOf[0] || boundsMax != instanceBoundsOf[1])
+        {
+            instanceBoundsMatrices = modelMatrices;
+            instanceBoundsOf[0] = boundsMin;
+            instanceBoundsOf[1] = boundsMax;
+            instancesMin = glm::vec3(FLT_MAX);
+            instancesMax = glm::vec3(-FLT_MAX);
+            for (const glm::mat4 &matrix : modelMatrices)
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    glm::vec3 local(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y,
+                                    corner & 4 ? boundsMax.z : boundsMin.z);
+                    glm::vec3 world = glm::vec3(matrix * glm::vec4(local, 1.0f));
+                    instancesMin = glm::min(instancesMin, world);
+                    instancesMax = glm::max(instancesMax, world);
+                }
+        }
+        TextureResidency::instance().use(meshes, instancesMin, instancesMax, glm::mat4(1.0f));
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
+
+    // CPU half of loading, safe to call from any thread: reads the model from the mesh cache if possible,
+    // otherwise with ASSIMP (and caches the result for next time).
+    static bool importData(string const &path, ModelData &data)
+    {
+        LoadProfiler::Scope profile(LoadProfiler::assetOf(path), "import");
+        // a .gltf can go through either importer (LOGL_NO_NATIVE_GLTF), their results are cached apart
+        uint64_t sourceHash = MeshCache::sourceHash(path, importFlags, GltfLoader::handles(path) ? "gltf" : "assimp");
+        bool cached = sourceHash != 0 && MeshCache::load(path, sourceHash, data);
+        const char *method = "from mesh cache";
+        if (!cached)
+        {
+            if (!importModel(path, data, &method))
+                return false;
+            if (sourceHash != 0 && !MeshCache::store(path, sourceHash, data))
+                cout << "WARNING::MESH_CACHE:: could not write cache entry for " << path << endl;
+        }
+        cout << "MODEL::IMPORTED " << path << " " << method << endl;
+
+        if (getenv("LOGL_MESH_CACHE_BENCH"))
+            benchmarkImport(path, sourceHash);
+        return true;
+    }
+
+    // GL half: uploads one imported mesh. Textures another model already loaded are taken from the TextureCache,
+    // the others get a flat placeholder until setTexture.
+    void addMesh(const MeshData &data)
+    {
+        LoadProfiler::Scope profile(this->directory, "addMesh");
+        vector<Texture> textures = data.textures;
+        for (Texture &texture : textures)
+        {
+            unsigned int id = loadedTexture(texture.path);
+            if (id == 0)
+            {
+                id = TextureCache::instance().acquirePath(this->directory + '/' + texture.path);
+                if (id != 0)
+                    registerTexture(texture.path, texture.type, id);
+            }
+            texture.id = id != 0 ? id : PlaceholderTexture();
+        }
+        meshes.push_back(Mesh(data.vertices, data.indices, std::move(textures), data.lods, residency));
+        meshes.back().glslIdentifierPrefix = glslIdentifierPrefix;
+
+        const vector<MeshLod> &lods = meshes.back().lods;
+        if (lodErrors.size() < lods.size())
+            lodErrors.resize(lods.size(), lodErrors.empty() ? 0.0f : lodErrors.back());
+        // levels the mesh doesn't have are drawn with its coarsest one
+        for (unsigned int level = 0; level < lodErrors.size(); level++)
+            lodErrors[level] = max(lodErrors[level], lods[min(level, (unsigned int)lods.size() - 1)].error);
+
+        glm::vec3 meshMin(FLT_MAX), meshMax(-FLT_MAX);
+        for (const Vertex &vertex : data.vertices)
+        {
+            meshMin = glm::min(meshMin, vertex.Position);
+            meshMax = glm::max(meshMax, vertex.Position);
+        }
+        meshBounds.push_back(make_pair(meshMin, meshMax));
+        addBounds((unsigned int)meshes.size() - 1);
+    }
+
+    // where the meshes go, see nodes. Set it before or after adding the meshes, nodes of meshes that aren't added yet
+    // are left out of drawing until they are.
+    void setNodes(const vector<MeshNode> &meshNodes)
+    {
+        nodes = meshNodes;
+        boundsMin = glm::vec3(FLT_MAX);
+        boundsMax = glm::vec3(-FLT_MAX);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            addBounds(i);
+    }
+
+    // paths (relative to directory) of all textures the meshes reference that aren't loaded yet, each once
+    vector<string> missingTextures() const
+    {
+        vector<string> paths;
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                if (loadedTexture(texture.path) == 0 && find(paths.begin(), paths.end(), texture.path) == paths.end())
+                    paths.push_back(texture.path);
+        return paths;
+    }
+
+    // registers a loaded texture and swaps it in for the placeholder on every mesh that uses it
+    void setTexture(string const &path, unsigned int id)
+    {
+        for (Mesh &mesh : meshes)
+        {
+            for (Texture &texture : mesh.textures)
+            {
+                if (texture.path == path)
+                {
+                    texture.id = id;
+                    if (loadedTexture(path) == 0)
+                        registerTexture(path, texture.type, id);
+                }
+            }
+        }
+    }
+
+    // gives this model's references on its textures back to the TextureCache, which deletes the ones nobody uses anymore.
+    // The meshes keep drawing with the placeholder.
+    void ReleaseTextures()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureCache::instance().release(texture.id);
+        for (Mesh &mesh : meshes)
+            for (Texture &texture : mesh.textures)
+                texture.id = PlaceholderTexture();
+        textures_loaded.clear();
+        loadedByPath.clear();
+    }
+
+    // gives the meshes' geometry back to the GeometryArena, for another model to reuse. The model draws nothing afterwards.
+    void ReleaseGeometry()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.ReleaseGeometry();
+    }
+
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // aInstanceModel in model_lighting.vs, right after the attributes of PackedVertex
+    static const GLuint INSTANCE_MODEL_LOCATION = 4;
+
+    // per-instance model matrices for DrawInstanced, grouped by level of detail
+    unsigned int instanceVBO = 0;
+    size_t instanceCapacity = 0;
+    vector<glm::mat4> instanceMatrices, uploadedMatrices;
+    // world space box around the instances UseTextures was last given, and what it was computed from
+    vector<glm::mat4> instanceBoundsMatrices;
+    glm::vec3 instanceBoundsOf[2];
+    glm::vec3 instancesMin, instancesMax;
+
+    std::string glslIdentifierPrefix;
+    // texture path (relative to directory) -> id, for O(1) lookups into textures_loaded
+    unordered_map<string, unsigned int> loadedByPath;
+    // level of detail each instance was drawn with last
+    vector<unsigned int> instanceLods;
+    // model space bounding box of each mesh, before node transforms
+    vector<pair<glm::vec3, glm::vec3>> meshBounds;
+
+    // draws every mesh where the nodes put it, at level and instanceCount times, with the GeometryArena bound. The caller
+    // has set "model" to modelMatrix already, only nodes that move away from it need the uniform.
+    void drawLevel(Shader &shader, const glm::mat4 &modelMatrix, unsigned int level, unsigned int instanceCount)
+    {
+        size_t drawn = 0, full = 0;
+        auto draw = [&](Mesh &mesh) {
+            mesh.DrawBound(shader, level, instanceCount);
+            drawn += mesh.lods[std::min(level, (unsigned int)mesh.lods.size() - 1)].indexCount / 3 * instanceCount;
+            full += mesh.lods[0].indexCount / 3 * instanceCount;
+        };
+        if (nodes.empty())
+        {
+            for (Mesh &mesh : meshes)
+                draw(mesh);
+        }
+        else
+        {
+            static constexpr UniformName model("model");
+            const glm::mat4 identity(1.0f);
+            const glm::mat4 *current = &identity;
+            for (const MeshNode &node : nodes)
+            {
+                if (node.mesh >= meshes.size())
+                    continue;  // still loading
+                if (node.transform != *current)
+                {
+                    shader.setMat4(model, modelMatrix * node.transform);
+                    current = &node.transform;
+                }
+                draw(meshes[node.mesh]);
+            }
+            if (*current != identity)
+                shader.setMat4(model, modelMatrix);
+        }
+        LodSelector::instance().count(drawn, full);
+    }
+
+    // grows the model's bounds by mesh wherever the nodes put it
+    void addBounds(unsigned int mesh)
+    {
+        const glm::vec3 &meshMin = meshBounds[mesh].first, &meshMax = meshBounds[mesh].second;
+        if (meshMin.x > meshMax.x)
+            return;
+        auto add = [&](const glm::mat4 &transform) {
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 point(corner & 1 ? meshMax.x : meshMin.x, corner & 2 ? meshMax.y : meshMin.y, corner & 4 ? meshMax.z : meshMin.z);
+                glm::vec3 placed = glm::vec3(transform * glm::vec4(point, 1.0f));
+                boundsMin = glm::min(boundsMin, placed);
+                boundsMax = glm::max(boundsMax, placed);
+            }
+        };
+        if (nodes.empty())
+            add(glm::mat4(1.0f));
+        for (const MeshNode &node : nodes)
+            if (node.mesh == mesh)
+                add(node.transform);
+    }
+
+    // loads the whole model right away and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        LoadProfiler::Scope profile(LoadProfiler::assetOf(path), "loadModel");
+        auto start = chrono::steady_clock::now();
+
+        ModelData data;
+        if (!importData(path, data))
+            return;
+        directory = data.directory;
+
+        setNodes(data.nodes);
+        for (const MeshData &mesh : data.meshes)
+            addMesh(mesh);
+        loadTextures();
+
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "MODEL::LOADED " << path << " in " << ms << " ms" << endl;
+    }
+
+    // cold (ASSIMP) vs warm (mesh cache) import of the same file, CPU side only. Enabled with LOGL_MESH_CACHE_BENCH=1.
+    static void benchmarkImport(string const &path, uint64_t sourceHash)
+    {
+        ModelData cold, warm;
+        auto t0 = chrono::steady_clock::now();
+        bool imported = importModel(path, cold);
+        auto t1 = chrono::steady_clock::now();
+        bool hit = MeshCache::load(path, sourceHash, warm);
+        // touch every page of the mapping, otherwise we would only be timing mmap itself
+        float checksum = 0.0f;
+        for (const MeshData &mesh : warm.meshes)
+        {
+            for (const Vertex &vertex : mesh.vertices)
+                checksum += vertex.Position.x;
+            for (unsigned int index : mesh.indices)
+                checksum += index;
+        }
+        auto t2 = chrono::steady_clock::now();
+
+        if (!imported || !hit)
+            return;
+        double coldMs = chrono::duration<double, milli>(t1 - t0).count();
+        double warmMs = chrono::duration<double, milli>(t2 - t1).count();
+        cout << "MESH_CACHE::BENCH " << path << " cold " << coldMs << " ms, warm " << warmMs << " ms, speedup "
+             << (warmMs > 0.0 ? coldMs / warmMs : 0.0) << "x (" << checksum << ")" << endl;
+    }
+
+    // reads a model from file and converts it into CPU side mesh data: .gltf with the GltfLoader, everything else
+    // (or a .gltf the GltfLoader can't handle) with ASSIMP. method, if given, says which one it was.
+    static bool importModel(string const &path, ModelData &data, const char **method = nullptr)
+    {
+        if (GltfLoader::handles(path))
+        {
+            if (GltfLoader::import(path, data))
+            {
+                placeNodes(data.nodes);
+                optimizeMeshes(path, data);
+                if (method)
+                    *method = "with the glTF loader";
+                return true;
+            }
+            cout << "GLTF:: falling back to ASSIMP for " << path << endl;
+            data = ModelData();
+        }
+        if (method)
+            *method = "with ASSIMP";
+
+        // read file via ASSIMP, the importer owns (and deletes) the IO handler
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        importer.SetIOHandler(new AssetIOSystem());
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
         // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        data.directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<int> imported(scene->mNumMeshes, -1);
+        processNode(scene->mRootNode, scene, data, glm::mat4(1.0f), imported);
+        placeNodes(data.nodes);
+        optimizeMeshes(path, data);
+        return true;
+    }
+
+    // makes the node transforms relative to the first node's. Every model in the scene was placed back when node
+    // transforms were ignored, that is as if each mesh sat at the first one's transform. Models whose meshes all
+    // share one transform keep looking exactly the same, parts placed by a transform of their own move into place.
+    static void placeNodes(vector<MeshNode> &nodes)
+    {
+        if (nodes.empty())
+            return;
+        glm::mat4 reference = glm::inverse(nodes[0].transform);
+        for (MeshNode &node : nodes)
+        {
+            node.transform = reference * node.transform;
+            // rounding shouldn't cost shared transforms their (cheap to draw) identity
+            const glm::mat4 identity(1.0f);
+            bool nearIdentity = true;
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    nearIdentity = nearIdentity && fabs(node.transform[column][row] - identity[column][row]) < 1e-5f;
+            if (nearIdentity)
+                node.transform = identity;
+        }
+    }
+
+    // reorders the freshly imported triangles and vertices for the post-transform cache, overdraw and vertex fetch,
+    // then adds the coarser levels of detail. Runs before the result goes into the mesh cache, so only a cold import
+    // pays for it.
+    static void optimizeMeshes(string const &path, ModelData &data)
+    {
+        LoadProfiler::Scope profile(LoadProfiler::assetOf(path), "optimize");
+        auto start = chrono::steady_clock::now();
+        VertexCacheStatistics before, after;
+        vector<size_t> lodTriangles;
+        for (unsigned int i = 0; i < data.meshes.size(); i++)
+        {
+            vector<Vertex> &vertices = data.ownedVertices[i];
+            vector<unsigned int> &indices = data.ownedIndices[i];
+            before += MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+            MeshOptimizer::optimize(vertices, indices);
+            after += MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+            MeshSimplifier::buildLods(vertices, indices, data.meshes[i].lods);
+            for (unsigned int level = 0; level < MeshSimplifier::MAX_LEVELS; level++)
+            {
+                const vector<MeshLod> &lods = data.meshes[i].lods;
+                if (lodTriangles.size() <= level)
+                    lodTriangles.push_back(0);
+                lodTriangles[level] += lods[min(level, (unsigned int)lods.size() - 1)].indexCount / 3;
+            }
+
+            data.meshes[i].vertices = Span<Vertex>(vertices.data(), vertices.size());
+            data.meshes[i].indices = Span<unsigned int>(indices.data(), indices.size());
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "MESH_OPTIMIZER:: " << path << " ACMR " << before.acmr() << " -> " << after.acmr() << ", ATVR "
+             << before.atvr() << " -> " << after.atvr() << ", levels of detail";
+        for (size_t triangles : lodTriangles)
+            cout << " " << triangles;
+        cout << " triangles (" << ms << " ms)" << endl;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // A mesh is processed the first time a node references it, imported maps ASSIMP's mesh index to ours (-1: not yet).
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data, const glm::mat4 &parentTransform, vector<int> &imported)
     {
+        // ASSIMP's matrices are row major
+        const aiMatrix4x4 &m = node->mTransformation;
+        glm::mat4 local(glm::vec4(m.a1, m.b1, m.c1, m.d1), glm::vec4(m.a2, m.b2, m.c2, m.d2),
+                        glm::vec4(m.a3, m.b3, m.c3, m.d3), glm::vec4(m.a4, m.b4, m.c4, m.d4));
+        glm::mat4 transform = parentTransform * local;
+
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            unsigned int index = node->mMeshes[i];
+            if (imported[index] < 0)
+            {
+                imported[index] = (int)data.meshes.size();
+                data.meshes.push_back(processMesh(scene->mMeshes[index], scene, data));
+            }
+            data.nodes.push_back(MeshNode{ (unsigned int)imported[index], transform });
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data, transform, imported);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, ModelData &data)
     {
+        LoadProfiler::Scope profile(data.directory, "processMesh");
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
+        data.ownedVertices.emplace_back();
+        data.ownedIndices.emplace_back();
+        vector<Vertex> &vertices = data.ownedVertices.back();
+        vector<unsigned int> &indices = data.ownedIndices.back();
         vector<Texture> textures;
-
+        vertices.reserve(mesh->mNumVertices);
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -178,42 +698,67 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, the spans point into the arrays owned by data
+        MeshData meshData;
+        meshData.vertices = Span<Vertex>(vertices.data(), vertices.size());
+        meshData.indices = Span<unsigned int>(indices.data(), indices.size());
+        meshData.textures = textures;
+        profile.geometry(vertices.size(), indices.size());
+        return meshData;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type. Only type and path are filled in here,
+    // the actual texture objects get created (or reused) by loadTextures.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
+        LoadProfiler::Scope profile("loadMaterialTextures");
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // loads all textures the meshes reference that aren't loaded yet. The images are decoded in parallel
+    // on the thread pool, only the upload happens here on the GL thread.
+    void loadTextures()
+    {
+        vector<string> paths = missingTextures();
+        vector<string> files;
+        for (const string &path : paths)
+            files.push_back(this->directory + '/' + path);
+        // images whose content is resident already (under any path) aren't decoded again
+        TextureCache &cache = TextureCache::instance();
+        vector<future<DecodedImage>> decoding = ImageDecoder::decodeAllAsync(files, false, cache.skipResident());
+
+        // upload in the order the decodes were queued, the later ones keep decoding meanwhile
+        for (unsigned int i = 0; i < paths.size(); i++)
+            setTexture(paths[i], cache.acquire(decoding[i].get()));
+    }
+
+    unsigned int loadedTexture(const string &path) const
+    {
+        auto found = loadedByPath.find(path);
+        return found != loadedByPath.end() ? found->second : 0;
+    }
+
+    // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    void registerTexture(const string &path, const string &type, unsigned int id)
+    {
+        Texture texture;
+        texture.id = id;
+        texture.type = type;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        loadedByPath[path] = id;
+    }
 };
 
 
@@ -221,39 +766,10 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    LoadProfiler::Scope profile(LoadProfiler::assetOf(filename), "TextureFromFile");
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    TextureCache &cache = TextureCache::instance();
+    unsigned int id = cache.acquirePath(filename);
+    return id != 0 ? id : cache.acquire(ImageDecoder::decode(filename, false, cache.skipResident()));
 }
 #endif
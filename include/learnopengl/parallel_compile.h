@@ -0,0 +1,76 @@
+#ifndef PARALLEL_COMPILE_H
+#define PARALLEL_COMPILE_H
+
+#include <glad/glad.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile, neither is part of the GL 3.3 core glad was generated for
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Lets the driver compile and link on its own threads, with GL_KHR_parallel_shader_compile a program can be asked
+// whether it is done without waiting. Without it (or with LOGL_SYNC_SHADERS=1) finishing a program blocks.
+class ParallelCompile
+{
+public:
+    // once, after gladLoadGLLoader
+    static void init(GLADloadproc load)
+    {
+        if (getenv("LOGL_SYNC_SHADERS") != nullptr)
+            return;
+        MaxShaderCompilerThreadsProc maxThreads = nullptr;
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+        if (!maxThreads)
+            return;
+        // as many threads as the implementation likes
+        maxThreads(0xFFFFFFFF);
+        available() = true;
+        std::cout << "SHADER:: compiling in parallel" << std::endl;
+    }
+
+    static bool supported()
+    {
+        return available();
+    }
+
+    // true once the driver has finished linking program, never blocks
+    static bool linked(GLuint program)
+    {
+        if (!available())
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+private:
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+    static bool &available()
+    {
+        static bool parallel = false;
+        return parallel;
+    }
+
+    static bool hasExtension(const char *extension)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (name && std::strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif
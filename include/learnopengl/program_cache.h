@@ -0,0 +1,202 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ARB_get_program_binary (core in 4.1), glad was generated for plain 3.3 so the tokens and entry points come from here
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+// Linked program binaries in resources/cache, keyed by the shader sources and the driver. init() once after
+// gladLoadGLLoader, LOGL_NO_PROGRAM_CACHE=1 turns it off.
+class ProgramCache
+{
+public:
+    // bump whenever the file layout changes
+    static const uint32_t VERSION = 1;
+
+    static void init(GLADloadproc load)
+    {
+        ProgramCache &cache = instance();
+        cache.getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+        cache.programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+        cache.programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+
+        // a driver can have the entry points and still not support a single binary format
+        GLint formatCount = 0;
+        if (cache.getProgramBinary && cache.programBinary && cache.programParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        cache.active = formatCount > 0 && getenv("LOGL_NO_PROGRAM_CACHE") == nullptr;
+        if (!cache.active)
+            return;
+
+        std::string driver;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const char *value = reinterpret_cast<const char*>(glGetString(name));
+            driver += value ? value : "";
+            driver += '\n';
+        }
+        cache.formats.resize(formatCount);
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, cache.formats.data());
+        cache.driverHash = hashBytes(cache.formats.data(), cache.formats.size() * sizeof(GLint), hashString(driver));
+    }
+
+    static bool enabled()
+    {
+        return instance().active;
+    }
+
+    // what a program is looked up by: all of its stage sources, in order, and the driver
+    static uint64_t key(const std::vector<std::string> &sources)
+    {
+        uint64_t hash = instance().driverHash;
+        for (const std::string &source : sources)
+        {
+            uint64_t length = source.size();
+            hash = hashBytes(&length, sizeof(length), hash);
+            hash = hashString(source, hash);
+        }
+        return hash;
+    }
+
+    static std::string cachePath(uint64_t key)
+    {
+        return "resources/cache/" + hashToHex(key) + ".program";
+    }
+
+    // call before glLinkProgram, some drivers only keep a retrievable binary around when asked to
+    static void prepare(GLuint program)
+    {
+        if (enabled())
+            instance().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // loads the cached binary into program. False on a miss, a stale entry or a binary the driver rejects,
+    // program then needs to be built from source.
+    static bool load(GLuint program, uint64_t key)
+    {
+        if (!enabled())
+            return false;
+        std::shared_ptr<MappedFile> file = MappedFile::open(cachePath(key));
+        if (!file || file->size() < sizeof(ProgramCacheHeader))
+            return false;
+        LoadProfiler::bytesRead(file->size());
+
+        ProgramCacheHeader header;
+        memcpy(&header, file->data(), sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION || header.key != key
+            || header.size != file->size() - sizeof(header))
+            return false;
+        const std::vector<GLint> &formats = instance().formats;
+        if (std::find(formats.begin(), formats.end(), (GLint)header.format) == formats.end())
+            return false;
+
+        instance().programBinary(program, header.format, file->data() + sizeof(header), (GLsizei)header.size);
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            std::cout << "PROGRAM_CACHE:: driver rejected " << cachePath(key) << ", compiling from source" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // writes the binary of a successfully linked program
+    static bool store(GLuint program, uint64_t key)
+    {
+        if (!enabled())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        instance().getProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return false;
+
+        mkdir("resources", 0755);
+        mkdir("resources/cache", 0755);
+        // temporary file first, a crash never leaves a torn entry behind
+        std::string finalPath = cachePath(key);
+        std::string tmpPath = finalPath + ".tmp";
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        ProgramCacheHeader header;
+        memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.version = VERSION;
+        header.format = format;
+        header.key = key;
+        header.size = (uint64_t)written;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+        out.close();
+        if (!out)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return std::rename(tmpPath.c_str(), finalPath.c_str()) == 0;
+    }
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    static constexpr const char *MAGIC = "LOGLPROG";
+
+    struct ProgramCacheHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint64_t key;
+        uint64_t size;
+    };
+
+    bool active = false;
+    std::vector<GLint> formats;
+    uint64_t driverHash = FNV1A_OFFSET_BASIS;
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+
+    static ProgramCache &instance()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+};
+
+#endif
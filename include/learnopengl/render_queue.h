@@ -0,0 +1,236 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// the passes a frame is drawn in, in this order. Transparent packets are sorted back to front instead of front to back.
+enum RenderPass
+{
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_TRANSPARENT = 1
+};
+
+// one mesh to draw: with which shader, at which level of detail and where
+struct DrawPacket {
+    Shader   *shader;
+    Mesh     *mesh;
+    unsigned int level;
+    glm::mat4 modelMatrix;
+    // identifies the mesh's textures (and the sampler names they get bound to), equal hashes bind the same
+    uint64_t  material;
+};
+
+// Collects a frame's draws, radix sorts them by a 64 bit key (pass | shader | material | VAO | depth) and issues
+// them switching only the state that changes.
+class RenderQueue
+{
+public:
+    // what the last execute() did
+    struct Stats {
+        size_t packets = 0;
+        double sortMs = 0.0;
+        unsigned int shaderChanges = 0;
+        unsigned int materialChanges = 0;
+        unsigned int vaoChanges = 0;
+        unsigned int matrixChanges = 0;
+    };
+
+    // call once per frame before submitting, depth is measured from cameraPosition and scaled to farPlane
+    void beginFrame(const glm::vec3 &cameraPosition, float farPlane)
+    {
+        camera = cameraPosition;
+        this->farPlane = farPlane;
+        packets.clear();
+        keys.clear();
+    }
+
+    void submit(Shader &shader, Mesh &mesh, unsigned int level, const glm::mat4 &modelMatrix, RenderPass pass = RENDER_PASS_OPAQUE)
+    {
+        DrawPacket packet;
+        packet.shader = &shader;
+        packet.mesh = &mesh;
+        packet.level = level;
+        packet.modelMatrix = modelMatrix;
+        packet.material = materialHash(mesh);
+
+        // distance to the center of the mesh's bounds, which its position quantization spans
+        glm::vec3 center = mesh.quantization.offset + mesh.quantization.scale * 32767.5f;
+        float distance = glm::length(glm::vec3(modelMatrix * glm::vec4(center, 1.0f)) - camera);
+        uint64_t depth = (uint64_t)(std::min(std::max(distance / farPlane, 0.0f), 1.0f) * (float)DEPTH_MASK);
+        if (pass == RENDER_PASS_TRANSPARENT)
+            depth = DEPTH_MASK - depth;
+
+        uint64_t key = (uint64_t)pass << PASS_SHIFT;
+        key |= (uint64_t)(shader.ID & 0xff) << SHADER_SHIFT;
+        key |= (packet.material & 0xffff) << MATERIAL_SHIFT;
+        key |= (uint64_t)(VERTEX_ARRAY_ARENA & 0xff) << VAO_SHIFT;
+        key |= depth;
+
+        packets.push_back(packet);
+        keys.push_back(key);
+    }
+
+    // sorts and draws everything submitted since beginFrame
+    void execute()
+    {
+        stats = Stats();
+        stats.packets = packets.size();
+        auto start = std::chrono::steady_clock::now();
+        radixSort(keys, order, sortedKeys, sortedOrder);
+        stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        static constexpr UniformName model("model");
+        Shader *shader = nullptr;
+        uint64_t material = 0;
+        unsigned int vao = NO_VERTEX_ARRAY;
+        bool haveMaterial = false, haveMatrix = false;
+        glm::mat4 modelMatrix;
+        for (uint32_t index : order)
+        {
+            DrawPacket &packet = packets[index];
+            if (packet.shader != shader)
+            {
+                shader = packet.shader;
+                shader->use();
+                stats.shaderChanges++;
+                // samplers and uniforms belong to the program, the new one has none of ours yet, and it may read
+                // other attributes
+                haveMaterial = haveMatrix = false;
+                vao = NO_VERTEX_ARRAY;
+            }
+            if (vao != VERTEX_ARRAY_ARENA)
+            {
+                GeometryArena<PackedVertex>::instance().bind(shader->attributeMask);
+                vao = VERTEX_ARRAY_ARENA;
+                stats.vaoChanges++;
+            }
+            if (!haveMaterial || packet.material != material)
+            {
+                packet.mesh->BindTextures(*shader);
+                material = packet.material;
+                haveMaterial = true;
+                stats.materialChanges++;
+            }
+            if (!haveMatrix || packet.modelMatrix != modelMatrix)
+            {
+                shader->setMat4(model, packet.modelMatrix);
+                modelMatrix = packet.modelMatrix;
+                haveMatrix = true;
+                stats.matrixChanges++;
+            }
+            packet.mesh->DrawGeometry(*shader, packet.level);
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+
+        if (!packets.empty())
+        {
+            frames++;
+            total.packets += stats.packets;
+            total.sortMs += stats.sortMs;
+            total.shaderChanges += stats.shaderChanges;
+            total.materialChanges += stats.materialChanges;
+            total.vaoChanges += stats.vaoChanges;
+            total.matrixChanges += stats.matrixChanges;
+        }
+        packets.clear();
+        keys.clear();
+    }
+
+    // least significant digit radix sort of keys, a byte per pass, stable. order gets the index every sorted key had.
+    // Bytes every key has in common are skipped, within a frame most of the high ones are. The scratch vectors only
+    // keep their memory from one call to the next.
+    static void radixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &order, std::vector<uint64_t> &keyScratch,
+                          std::vector<uint32_t> &orderScratch)
+    {
+        size_t count = keys.size();
+        order.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            order[i] = i;
+        keyScratch.resize(count);
+        orderScratch.resize(count);
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256] = { 0 };
+            for (uint64_t key : keys)
+                histogram[(key >> shift) & 0xff]++;
+            if (count == 0 || histogram[(keys[0] >> shift) & 0xff] == count)
+                continue;
+
+            size_t offsets[256];
+            size_t sum = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                offsets[digit] = sum;
+                sum += histogram[digit];
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t destination = offsets[(keys[i] >> shift) & 0xff]++;
+                keyScratch[destination] = keys[i];
+                orderScratch[destination] = order[i];
+            }
+            keys.swap(keyScratch);
+            order.swap(orderScratch);
+        }
+    }
+
+    const Stats &lastFrame() const
+    {
+        return stats;
+    }
+
+    void printReport() const
+    {
+        if (frames == 0)
+            return;
+        std::cout << "RENDER_QUEUE:: per frame over " << frames << " frames: " << total.packets / frames << " draws, sorted in "
+                  << total.sortMs / frames << " ms, " << total.shaderChanges / frames << " shader, "
+                  << total.materialChanges / frames << " texture set, " << total.vaoChanges / frames << " VAO and "
+                  << total.matrixChanges / frames << " model matrix changes" << std::endl;
+    }
+
+private:
+    static const int PASS_SHIFT = 60;
+    static const int SHADER_SHIFT = 52;
+    static const int MATERIAL_SHIFT = 36;
+    static const int VAO_SHIFT = 28;
+    static const uint64_t DEPTH_MASK = (1ull << VAO_SHIFT) - 1;
+    // every Mesh draws from the GeometryArena<PackedVertex>, the field is there for formats to come
+    static const unsigned int VERTEX_ARRAY_ARENA = 0;
+    static const unsigned int NO_VERTEX_ARRAY = ~0u;
+
+    glm::vec3 camera = glm::vec3(0.0f);
+    float farPlane = 100.0f;
+    std::vector<DrawPacket> packets;
+    std::vector<uint64_t> keys, sortedKeys;
+    std::vector<uint32_t> order, sortedOrder;
+    Stats stats, total;
+    size_t frames = 0;
+
+    static uint64_t materialHash(const Mesh &mesh)
+    {
+        uint64_t hash = hashString(mesh.glslIdentifierPrefix);
+        for (const Texture &texture : mesh.textures)
+        {
+            hash = hashBytes(&texture.id, sizeof(texture.id), hash);
+            hash = hashString(texture.type, hash);
+        }
+        return hash;
+    }
+};
+
+#endif
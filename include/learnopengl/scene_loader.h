@@ -0,0 +1,278 @@
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/model.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads models on worker threads, nearest first, and uploads them within a time budget per frame in update().
+// With asynchronous = false load() does everything on the spot.
+class SceneLoader
+{
+public:
+    explicit SceneLoader(bool asynchronous = true)
+        : asynchronous(asynchronous), start(std::chrono::steady_clock::now()), residentBefore(LoadProfiler::residentBytes())
+    {
+        std::cout << "MEMORY:: RSS before loading the scene " << residentBefore / (1024 * 1024) << " MiB" << std::endl;
+    }
+
+    ~SceneLoader()
+    {
+        // workers hold pointers into our requests, let them finish first
+        for (std::future<void> &job : imports)
+            job.wait();
+    }
+
+    SceneLoader(const SceneLoader&) = delete;
+    SceneLoader &operator=(const SceneLoader&) = delete;
+
+    // position is where the model is going to be drawn, it decides how early the model gets loaded
+    void load(Model &model, const std::string &path, const glm::vec3 &position)
+    {
+        std::unique_ptr<Request> request(new Request);
+        request->model = &model;
+        request->path = path;
+        request->position = position;
+        request->queued = std::chrono::steady_clock::now();
+
+        if (!asynchronous)
+        {
+            if (Model::importData(path, request->data))
+                finishNow(*request);
+            else
+                request->stage = Failed;
+            requests.push_back(std::move(request));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            waiting.push_back(request.get());
+        }
+        requests.push_back(std::move(request));
+        // every job imports whichever waiting model is nearest at the time it runs, not necessarily this one
+        imports.push_back(ThreadPool::shared().submit([this]() { importNearest(); }));
+    }
+
+    void setViewerPosition(const glm::vec3 &position)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        viewerPosition = position;
+    }
+
+    // does the GL side of loading for roughly budgetMs milliseconds, at least one step per call. Call once per frame.
+    void update(double budgetMs)
+    {
+        if (done())
+            return;
+
+        auto frameStart = std::chrono::steady_clock::now();
+        glm::vec3 viewer;
+        std::vector<Request*> active;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            viewer = viewerPosition;
+            for (std::unique_ptr<Request> &request : requests)
+                if (request->stage == Imported || request->stage == Texturing)
+                    active.push_back(request.get());
+        }
+
+        // nearest first on the GL side as well
+        std::sort(active.begin(), active.end(), [&viewer](const Request *a, const Request *b) {
+            return distance2(a->position, viewer) < distance2(b->position, viewer);
+        });
+
+        for (Request *request : active)
+        {
+            while (step(*request))
+            {
+                double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+                if (elapsed >= budgetMs)
+                    return;
+            }
+        }
+    }
+
+    bool done()
+    {
+        if (!reportedDone)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            unsigned int failed = 0;
+            for (std::unique_ptr<Request> &request : requests)
+            {
+                if (request->stage != Resident && request->stage != Failed)
+                    return false;
+                failed += request->stage == Failed;
+            }
+            reportedDone = true;
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "SCENE::LOADED " << requests.size() - failed << " models in " << ms << " ms";
+            if (failed > 0)
+                std::cout << ", " << failed << " failed to load";
+            std::cout << std::endl;
+            TextureCache::instance().printReport();
+            TextureResidency::instance().printReport();
+            GeometryArena<PackedVertex>::instance().printReport();
+            LoadProfiler::instance().report();
+            // LOGL_KEEP_MESH_DATA=1 keeps the CPU copies of the meshes, for comparison
+            uint64_t residentAfter = LoadProfiler::residentBytes();
+            std::cout << "MEMORY:: RSS after loading the scene " << residentAfter / (1024 * 1024) << " MiB ("
+                      << ((int64_t)residentAfter - (int64_t)residentBefore) / (1024 * 1024) << " MiB for the scene), mesh geometry "
+                      << Mesh::memoryStats().kept / 1024 << " KiB kept in RAM, " << Mesh::memoryStats().dropped / 1024
+                      << " KiB dropped after upload, index buffers " << Mesh::memoryStats().indexBytes / 1024 << " KiB ("
+                      << Mesh::memoryStats().wideIndexBytes / 1024 << " KiB as 32 bit)" << std::endl;
+        }
+        return true;
+    }
+
+private:
+    enum Stage { Waiting, Imported, Texturing, Resident, Failed };
+
+    struct Request {
+        Model *model;
+        std::string path;
+        glm::vec3 position;
+        std::chrono::steady_clock::time_point queued;
+        // written by the worker, read by the GL thread only after stage says Imported
+        ModelData data;
+        Stage stage = Waiting;
+
+        unsigned int meshesUploaded = 0;
+        std::vector<std::string> texturePaths;
+        std::vector<std::future<DecodedImage>> decoding;
+        // textures handed to the uploader that aren't complete yet
+        unsigned int uploading = 0;
+    };
+
+    bool asynchronous;
+    std::chrono::steady_clock::time_point start;
+    uint64_t residentBefore;
+    bool reportedDone = false;
+
+    std::vector<std::unique_ptr<Request>> requests;
+    std::vector<std::future<void>> imports;
+
+    // guards waiting, viewerPosition and the stage of requests the workers still own
+    std::mutex mutex;
+    std::vector<Request*> waiting;
+    glm::vec3 viewerPosition = glm::vec3(0.0f);
+
+    static float distance2(const glm::vec3 &a, const glm::vec3 &b)
+    {
+        glm::vec3 d = a - b;
+        return glm::dot(d, d);
+    }
+
+    Stage stageOf(const Request &request)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return request.stage;
+    }
+
+    // worker side
+    void importNearest()
+    {
+        Request *request;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto nearest = std::min_element(waiting.begin(), waiting.end(), [this](const Request *a, const Request *b) {
+                return distance2(a->position, viewerPosition) < distance2(b->position, viewerPosition);
+            });
+            request = *nearest;
+            waiting.erase(nearest);
+        }
+
+        bool imported = Model::importData(request->path, request->data);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        request->stage = imported ? Imported : Failed;
+    }
+
+    // GL side: one small piece of work on a request. Returns false when there was nothing to do right now.
+    bool step(Request &request)
+    {
+        // the worker may still be writing the stage of a request that just got imported
+        Stage stage = stageOf(request);
+        if (stage != Imported && stage != Texturing)
+            return false;
+
+        if (stage == Imported)
+        {
+            if (request.meshesUploaded < request.data.meshes.size())
+            {
+                request.model->directory = request.data.directory;
+                if (request.meshesUploaded == 0)
+                    request.model->setNodes(request.data.nodes);
+                request.model->addMesh(request.data.meshes[request.meshesUploaded++]);
+                return true;
+            }
+
+            // all geometry is on the GPU, drop the CPU side data and start decoding the textures
+            request.data = ModelData();
+            request.texturePaths = request.model->missingTextures();
+            for (const std::string &path : request.texturePaths)
+                request.decoding.push_back(ImageDecoder::decodeAsync(request.model->directory + '/' + path, false,
+                                                                     TextureCache::instance().skipResident()));
+            std::lock_guard<std::mutex> lock(mutex);
+            request.stage = Texturing;
+            return true;
+        }
+
+        for (unsigned int i = 0; i < request.decoding.size(); i++)
+        {
+            if (!request.decoding[i].valid() || request.decoding[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+            Model *model = request.model;
+            std::string path = request.texturePaths[i];
+            request.uploading++;
+            TextureCache::instance().acquireAsync(request.decoding[i].get(), false, [&request, model, path](unsigned int id) {
+                model->setTexture(path, id);
+                request.uploading--;
+            });
+            return true;
+        }
+
+        for (std::future<DecodedImage> &image : request.decoding)
+            if (image.valid())
+                return false;
+        if (request.uploading > 0)
+            return false;
+        // queued to fully textured, waiting for a worker and for frame time included
+        LoadProfiler::instance().record(LoadProfiler::assetOf(request.path), "scene",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - request.queued).count());
+        std::lock_guard<std::mutex> lock(mutex);
+        request.stage = Resident;
+        return false;
+    }
+
+    void finishNow(Request &request)
+    {
+        request.stage = Imported;
+        while (stageOf(request) != Resident)
+        {
+            if (!step(request))
+            {
+                for (std::future<DecodedImage> &image : request.decoding)
+                    if (image.valid())
+                        image.wait();
+                TextureUploader::instance().finish();
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,382 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/texture_residency.h>
+#include <learnopengl/texture_uploader.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+unsigned int TextureFromImage(const DecodedImage &image, bool clampAlpha = false);
+void SpecifyTexture(unsigned int textureID, const DecodedImage &image);
+void FinishTexture(unsigned int textureID, const DecodedImage &image, bool clampAlpha);
+unsigned int PlaceholderTexture();
+bool BlockCompressionSupported();
+
+// Process wide, reference counted cache of GL textures, found by canonical path or by a hash of the file contents.
+// GL thread only, except hasContent which decoder workers use.
+class TextureCache
+{
+public:
+    typedef std::function<void(unsigned int textureID)> Callback;
+
+    static TextureCache &instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    static std::string canonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+    }
+
+    // id of the texture already loaded from this file (with one more reference on it), 0 if there is none
+    unsigned int acquirePath(const std::string &path, bool clampAlpha = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = byPath.find(pathKey(canonicalPath(path), clampAlpha));
+        if (found == byPath.end())
+            return 0;
+        Entry &entry = entries[found->second];
+        reference(entry);
+        return entry.id;
+    }
+
+    // safe from any thread, meant for ImageDecoder::SkipPredicate. Counts textures still streaming in as well.
+    bool hasContent(uint64_t contentHash, bool clampAlpha = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t key = contentKey(contentHash, clampAlpha);
+        return byContent.count(key) != 0 || streaming.count(key) != 0;
+    }
+
+    ImageDecoder::SkipPredicate skipResident(bool clampAlpha = false)
+    {
+        return [this, clampAlpha](uint64_t contentHash) { return hasContent(contentHash, clampAlpha); };
+    }
+
+    // texture for a decoded image: reuses a resident texture with the same content, otherwise uploads the image
+    unsigned int acquire(const DecodedImage &image, bool clampAlpha = false)
+    {
+        std::string path = canonicalPath(image.path);
+        uint64_t key = contentKey(image.contentHash, clampAlpha);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = image.contentHash != 0 ? byContent.find(key) : byContent.end();
+            if (found != byContent.end())
+            {
+                Entry &entry = entries[found->second];
+                reference(entry);
+                byPath[pathKey(path, clampAlpha)] = entry.id;
+                return entry.id;
+            }
+            // still streaming in: share that texture, its pixels follow with the upload
+            auto pending = image.contentHash != 0 ? streaming.find(key) : streaming.end();
+            if (pending != streaming.end())
+            {
+                pending->second.waiting.push_back([](unsigned int) {});
+                pending->second.paths.push_back(pathKey(path, clampAlpha));
+                return pending->second.id;
+            }
+        }
+
+        // the decoder skipped it, but the resident copy went away in the meantime
+        if (image.skipped)
+            return acquire(ImageDecoder::decode(image.path), clampAlpha);
+
+        Entry entry;
+        entry.id = TextureFromImage(image, clampAlpha);
+        entry.contentKey = key;
+        entry.pathKey = pathKey(path, clampAlpha);
+        entry.bytes = TextureBytes(image);
+        entry.references = 1;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!image.valid())
+            return entry.id;   // failed loads are not cached, the next attempt may succeed
+        byPath[entry.pathKey] = entry.id;
+        byContent[key] = entry.id;
+        entries[entry.id] = entry;
+        TextureResidency::instance().track(entry.id, image, clampAlpha);
+        return entry.id;
+    }
+
+    // like acquire, but streams the image in through the TextureUploader. done gets the texture once it is complete,
+    // right away if it is resident already. Requests for content that is still on its way share that upload.
+    void acquireAsync(DecodedImage image, bool clampAlpha, Callback done)
+    {
+        std::string path = canonicalPath(image.path);
+        uint64_t key = contentKey(image.contentHash, clampAlpha);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto found = image.contentHash != 0 ? byContent.find(key) : byContent.end();
+            if (found != byContent.end())
+            {
+                Entry &entry = entries[found->second];
+                reference(entry);
+                byPath[pathKey(path, clampAlpha)] = entry.id;
+                unsigned int id = entry.id;
+                lock.unlock();
+                done(id);
+                return;
+            }
+            auto pending = image.contentHash != 0 ? streaming.find(key) : streaming.end();
+            if (pending != streaming.end())
+            {
+                pending->second.waiting.push_back(done);
+                pending->second.paths.push_back(pathKey(path, clampAlpha));
+                return;
+            }
+        }
+
+        if (image.skipped)
+            image = ImageDecoder::decode(image.path);
+        if (!image.valid())
+        {
+            done(TextureFromImage(image, clampAlpha));
+            return;
+        }
+
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Pending &pending = streaming[key];
+            pending.id = textureID;
+            pending.waiting.push_back(done);
+        }
+        TextureUploader::instance().enqueue(textureID, GL_TEXTURE_2D, std::move(image),
+                                            [this, textureID, key, path, clampAlpha](const DecodedImage &uploaded) {
+            FinishTexture(textureID, uploaded, clampAlpha);
+
+            Entry entry;
+            entry.id = textureID;
+            entry.contentKey = key;
+            entry.pathKey = pathKey(path, clampAlpha);
+            entry.bytes = TextureBytes(uploaded);
+            // the first request pays for the upload, every other one is a reuse
+            entry.references = 1;
+
+            std::vector<Callback> waiting;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Pending &pending = streaming[key];
+                waiting.swap(pending.waiting);
+                entries[textureID] = entry;
+                byPath[entry.pathKey] = textureID;
+                for (const std::string &other : pending.paths)
+                    byPath[other] = textureID;
+                streaming.erase(key);
+                byContent[key] = textureID;
+                for (size_t i = 1; i < waiting.size(); i++)
+                    reference(entries[textureID]);
+            }
+            TextureResidency::instance().track(textureID, uploaded, clampAlpha);
+            for (Callback &callback : waiting)
+                callback(textureID);
+        });
+    }
+
+    void release(unsigned int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(id);
+        if (found == entries.end() || --found->second.references > 0)
+            return;
+
+        for (auto it = byPath.begin(); it != byPath.end();)
+            it = it->second == id ? byPath.erase(it) : std::next(it);
+        byContent.erase(found->second.contentKey);
+        entries.erase(found);
+        TextureResidency::instance().untrack(id);
+        glDeleteTextures(1, &id);
+    }
+
+    size_t residentBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t bytes = 0;
+        for (auto &entry : entries)
+            bytes += entry.second.bytes;
+        return bytes;
+    }
+
+    void printReport()
+    {
+        size_t resident = residentBytes();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "TEXTURE_CACHE:: " << entries.size() << " textures, " << resident / 1024 << " KiB resident, "
+                  << reusedCount << " reuses saved " << savedBytes / 1024 << " KiB" << std::endl;
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        uint64_t contentKey;
+        std::string pathKey;
+        size_t bytes;
+        unsigned int references;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    std::unordered_map<unsigned int, Entry> entries;
+    // a texture the TextureUploader is still streaming in, with everyone that asked for it meanwhile: a callback
+    // (a reference) each, and the paths of the requests after the first
+    struct Pending {
+        unsigned int id = 0;
+        std::vector<Callback> waiting;
+        std::vector<std::string> paths;
+    };
+    // content key -> texture still streaming in
+    std::unordered_map<uint64_t, Pending> streaming;
+    size_t reusedCount = 0;
+    size_t savedBytes = 0;
+
+    TextureCache() {}
+
+    // the same pixels with a different wrap mode are a different texture object
+    static std::string pathKey(const std::string &canonical, bool clampAlpha)
+    {
+        return clampAlpha ? canonical + "#clamp" : canonical;
+    }
+
+    static uint64_t contentKey(uint64_t contentHash, bool clampAlpha)
+    {
+        return hashBytes(&clampAlpha, sizeof(clampAlpha), contentHash);
+    }
+
+    void reference(Entry &entry)
+    {
+        entry.references++;
+        reusedCount++;
+        savedBytes += entry.bytes;
+    }
+};
+
+// uploads an already decoded image. clampAlpha clamps textures with an alpha channel to the edge
+// instead of repeating them, which avoids semi-transparent borders on things like grass quads.
+unsigned int TextureFromImage(const DecodedImage &image, bool clampAlpha)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.valid())
+    {
+        SpecifyTexture(textureID, image);
+        FinishTexture(textureID, image, clampAlpha);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    return textureID;
+}
+
+// (re)specifies the texture with the image, for compressed images with their whole baked mip chain
+void SpecifyTexture(unsigned int textureID, const DecodedImage &image)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (image.isCompressed())
+    {
+        const CompressedImage &compressed = image.compressed;
+        for (unsigned int i = 0; i < compressed.levels.size(); i++)
+        {
+            const CompressedLevel &level = compressed.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, compressed.glFormat, level.width, level.height, 0, (GLsizei)level.size, level.data);
+        }
+    }
+    else
+    {
+        GLenum format = image.pixelFormat();
+        if (format == 0)
+        {
+            std::cout << "ERROR::TEXTURE::UNSUPPORTED_CHANNEL_COUNT " << image.components << " in " << image.path << std::endl;
+            return;
+        }
+
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    }
+}
+
+// everything after the pixels are in: mipmaps and sampling state
+void FinishTexture(unsigned int textureID, const DecodedImage &image, bool clampAlpha)
+{
+    bool alpha = image.isCompressed() ? image.compressed.hasAlpha() : image.components == 2 || image.components == 4;
+    GLint wrap = clampAlpha && alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (image.isCompressed())
+    {
+        // the mip chain was baked along
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.compressed.levels.size() - 1);
+        // grey images are baked to a single channel, spread it over rgb again like the source had it
+        if (image.compressed.format == BC4)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+    }
+    else
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        // grey + alpha comes in as red + green, read it back the way the source had it
+        if (image.components == 2)
+        {
+            GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// 1x1 light grey texture that stands in for textures still being loaded, so meshes show up with a flat material
+unsigned int PlaceholderTexture()
+{
+    static unsigned int textureID = 0;
+    if (textureID == 0)
+    {
+        const unsigned char texel[3] = { 200, 200, 200 };
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    return textureID;
+}
+
+// whether the driver takes the formats the texture baker writes. BC4/BC5 (RGTC) are core, BC1/BC3 need S3TC.
+bool BlockCompressionSupported()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
+
+#endif
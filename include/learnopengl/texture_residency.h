@@ -0,0 +1,400 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// defined in texture_cache.h
+void SpecifyTexture(unsigned int textureID, const DecodedImage &image);
+void FinishTexture(unsigned int textureID, const DecodedImage &image, bool clampAlpha);
+
+// levels of a full mip chain down to 1x1
+inline int MipLevels(int width, int height)
+{
+    return 1 + (int)std::floor(std::log2((double)std::max(std::max(width, height), 1)));
+}
+
+// what the driver keeps for levels mip levels of a width x height texture in internalFormat. Block compressed formats
+// take 8 or 16 bytes per 4x4 block, 3 channel textures are stored padded to 4 bytes a texel.
+inline size_t TextureBytes(GLenum internalFormat, int width, int height, int levels)
+{
+    size_t blockBytes = 0, texelBytes = 4;
+    switch (internalFormat)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+            blockBytes = 8;
+            break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+            blockBytes = 16;
+            break;
+        case GL_RED:
+        case GL_R8:
+            texelBytes = 1;
+            break;
+        case GL_RG:
+        case GL_RG8:
+            texelBytes = 2;
+            break;
+    }
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++)
+    {
+        size_t w = (size_t)std::max(width >> level, 1), h = (size_t)std::max(height >> level, 1);
+        bytes += blockBytes ? (w + 3) / 4 * ((h + 3) / 4) * blockBytes : w * h * texelBytes;
+    }
+    return bytes;
+}
+
+// the internal format SpecifyTexture uploads image with
+inline GLenum TextureFormat(const DecodedImage &image)
+{
+    return image.isCompressed() ? image.compressed.glFormat : image.pixelFormat();
+}
+
+// image's footprint once uploaded, with the baked mip chain or the one glGenerateMipmap makes
+inline size_t TextureBytes(const DecodedImage &image)
+{
+    int levels = image.isCompressed() ? (int)image.compressed.levels.size() : MipLevels(image.width, image.height);
+    return TextureBytes(TextureFormat(image), image.width, image.height, levels);
+}
+
+// Keeps the scene's textures within a VRAM budget by dropping top mip levels of the least recently used and smallest
+// on screen ones, and reloads them once there is room again.
+class TextureResidency
+{
+public:
+    static TextureResidency &instance()
+    {
+        static TextureResidency residency;
+        return residency;
+    }
+
+    // LOGL_TEXTURE_BUDGET_MB overrides the default of 256 MiB
+    TextureResidency()
+    {
+        const char *budgetMb = getenv("LOGL_TEXTURE_BUDGET_MB");
+        budget = (size_t)(budgetMb ? atof(budgetMb) : 256.0) * 1024 * 1024;
+    }
+
+    void setBudget(size_t bytes)
+    {
+        budget = bytes;
+    }
+
+    size_t residentBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &entry : entries)
+            bytes += entry.second.bytes;
+        return bytes;
+    }
+
+    // called by the TextureCache for every texture it uploads from a file, and when it deletes one again
+    void track(unsigned int textureID, const DecodedImage &image, bool clampAlpha)
+    {
+        if (!image.valid())
+            return;
+        Entry &entry = entries[textureID];
+        entry = Entry();
+        entry.id = textureID;
+        entry.path = image.path;
+        entry.clampAlpha = clampAlpha;
+        entry.width = image.width;
+        entry.height = image.height;
+        entry.components = image.components;
+        entry.compressed = image.isCompressed();
+        entry.glFormat = TextureFormat(image);
+        entry.levels = entry.compressed ? (int)image.compressed.levels.size() : MipLevels(image.width, image.height);
+        entry.fullBytes = entry.bytes = TextureBytes(image);
+        entry.lastUsed = frame;
+    }
+
+    void untrack(unsigned int textureID)
+    {
+        entries.erase(textureID);
+        // the name may get reused for another texture before the reload finishes
+        if (textureID == reloadID)
+            reloadID = 0;
+    }
+
+    // camera of the frame about to be drawn, call before the first use()
+    void beginFrame(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition, int viewportHeight)
+    {
+        frame++;
+        this->cameraPosition = cameraPosition;
+        pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+
+        // frustum planes straight from the rows of the view projection matrix
+        glm::mat4 viewProjection = projection * view;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int side = 0; side < 2; side++)
+            {
+                glm::vec4 &plane = frustum[i * 2 + side];
+                float sign = side == 0 ? 1.0f : -1.0f;
+                for (int c = 0; c < 4; c++)
+                    plane[c] = viewProjection[c][3] + sign * viewProjection[c][i];
+                plane = plane / glm::length(glm::vec3(plane.x, plane.y, plane.z));
+            }
+        }
+    }
+
+    // meshes with the model space bounding box boundsMin - boundsMax are about to be drawn with modelMatrix.
+    // Textures of meshes outside the view don't count as used.
+    void use(const std::vector<Mesh> &meshes, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &modelMatrix)
+    {
+        if (boundsMin.x > boundsMax.x)
+            return;
+        glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(localCenter, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        float radius = glm::length(boundsMax - localCenter) * scale;
+
+        for (const glm::vec4 &plane : frustum)
+            if (glm::dot(glm::vec3(plane.x, plane.y, plane.z), center) + plane.w < -radius)
+                return;
+
+        float distance = std::max(glm::length(center - cameraPosition) - radius, 0.01f);
+        float screenPixels = 2.0f * radius / distance * pixelsPerUnit;
+        for (const Mesh &mesh : meshes)
+            for (const Texture &texture : mesh.textures)
+                use(texture.id, screenPixels, distance);
+    }
+
+    // for textures drawn without a Model, like the grass quads
+    void use(unsigned int textureID, float screenPixels, float distance = 0.0f)
+    {
+        auto found = entries.find(textureID);
+        if (found == entries.end())
+            return;
+        Entry &entry = found->second;
+        if (entry.lastUsed != frame)
+        {
+            entry.screenPixels = 0.0f;
+            entry.distance = distance;
+        }
+        entry.lastUsed = frame;
+        entry.screenPixels = std::max(entry.screenPixels, screenPixels);
+        entry.distance = std::min(entry.distance, distance);
+    }
+
+    // shrinks or reloads textures as the budget asks for, call once per frame after drawing
+    void update()
+    {
+        finishReload();
+
+        size_t resident = residentBytes();
+        if (resident > budget)
+            shrink(resident);
+        else if (resident < budget * 9 / 10 && !reload.valid())
+            startReload(budget * 9 / 10 - resident);
+    }
+
+    void printReport() const
+    {
+        unsigned int reduced = 0, evicted = 0;
+        for (const auto &entry : entries)
+        {
+            reduced += entry.second.dropped > 0 && entry.second.dropped < entry.second.levels - 1;
+            evicted += entry.second.levels > 1 && entry.second.dropped == entry.second.levels - 1;
+        }
+        std::cout << "TEXTURE_RESIDENCY:: " << residentBytes() / 1024 << " KiB of " << budget / 1024 << " KiB budget, "
+                  << entries.size() << " textures, " << reduced << " reduced, " << evicted << " evicted" << std::endl;
+    }
+
+private:
+    // textures unused for this many frames are evicted when memory is short, the others only lose the mips they don't need
+    static const unsigned int EVICT_AFTER_FRAMES = 120;
+    // how many textures update() may shrink per frame, every one is a GPU read back
+    static const unsigned int SHRINKS_PER_FRAME = 4;
+
+    struct Entry {
+        unsigned int id = 0;
+        std::string path;
+        bool clampAlpha = false;
+        int width = 0, height = 0, components = 0;
+        bool compressed = false;
+        // internal format, see TextureFormat
+        unsigned int glFormat = 0;
+        // mip levels of the full texture, and how many of the top ones are currently dropped
+        int levels = 1;
+        int dropped = 0;
+        size_t fullBytes = 0;
+        size_t bytes = 0;
+        unsigned long lastUsed = 0;
+        float screenPixels = 0.0f;
+        float distance = 0.0f;
+    };
+
+    size_t budget;
+    std::unordered_map<unsigned int, Entry> entries;
+    unsigned long frame = 0;
+
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 1.0f;
+    glm::vec4 frustum[6];
+
+    // texture being reloaded from its file
+    unsigned int reloadID = 0;
+    std::future<DecodedImage> reload;
+
+    bool visible(const Entry &entry) const
+    {
+        return entry.lastUsed == frame;
+    }
+
+    // levels to drop so the top level still has about as many texels as the texture covers pixels on screen
+    int neededDrop(const Entry &entry) const
+    {
+        if (frame - entry.lastUsed > EVICT_AFTER_FRAMES)
+            return entry.levels - 1;
+        if (!visible(entry))
+            return entry.dropped;
+        float ratio = std::max(entry.width, entry.height) / std::max(entry.screenPixels, 1.0f);
+        return std::min(entry.levels - 1, std::max(0, (int)std::floor(std::log2(ratio))));
+    }
+
+    void shrink(size_t resident)
+    {
+        std::vector<Entry*> candidates;
+        for (auto &entry : entries)
+            candidates.push_back(&entry.second);
+        // least recently used first, among equally recent ones the smallest on screen
+        std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b) {
+            if (a->lastUsed != b->lastUsed)
+                return a->lastUsed < b->lastUsed;
+            return a->screenPixels < b->screenPixels;
+        });
+
+        unsigned int shrunk = 0;
+        for (Entry *entry : candidates)
+        {
+            if (resident <= budget || shrunk == SHRINKS_PER_FRAME)
+                return;
+            int drop = neededDrop(*entry);
+            if (drop <= entry->dropped)
+                continue;
+            resident -= entry->bytes;
+            respecify(*entry, drop);
+            resident += entry->bytes;
+            shrunk++;
+        }
+
+        // everything is at what it needs and it still doesn't fit: take one more level off the least important
+        for (Entry *entry : candidates)
+        {
+            if (resident <= budget || shrunk == SHRINKS_PER_FRAME)
+                return;
+            if (entry->dropped >= entry->levels - 1)
+                continue;
+            resident -= entry->bytes;
+            respecify(*entry, entry->dropped + 1);
+            resident += entry->bytes;
+            shrunk++;
+        }
+    }
+
+    // respecifies the texture with its top levels up to drop gone, from the mips that are on the GPU already
+    void respecify(Entry &entry, int drop)
+    {
+        int skip = drop - entry.dropped;
+        int levels = entry.levels - drop;
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (entry.compressed)
+        {
+            // keep the remaining baked levels as they are
+            std::vector<std::vector<unsigned char>> data(levels);
+            std::vector<GLint> widths(levels), heights(levels);
+            for (int i = 0; i < levels; i++)
+            {
+                GLint size;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, skip + i, GL_TEXTURE_WIDTH, &widths[i]);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, skip + i, GL_TEXTURE_HEIGHT, &heights[i]);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, skip + i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                data[i].resize(size);
+                glGetCompressedTexImage(GL_TEXTURE_2D, skip + i, data[i].data());
+            }
+            for (int i = 0; i < levels; i++)
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, entry.glFormat, widths[i], heights[i], 0, (GLsizei)data[i].size(), data[i].data());
+            entry.bytes = TextureBytes(entry.glFormat, widths[0], heights[0], levels);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+        else
+        {
+            GLint width, height;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, skip, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, skip, GL_TEXTURE_HEIGHT, &height);
+            GLenum format = entry.glFormat;
+            std::vector<unsigned char> pixels((size_t)width * height * entry.components);
+            glGetTexImage(GL_TEXTURE_2D, skip, format, GL_UNSIGNED_BYTE, pixels.data());
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels.data());
+            glGenerateMipmap(GL_TEXTURE_2D);
+            entry.bytes = TextureBytes(format, width, height, levels);
+        }
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        entry.dropped = drop;
+        std::cout << "TEXTURE_RESIDENCY::" << (drop == entry.levels - 1 ? "EVICTED " : "REDUCED ") << entry.path
+                  << " to level " << drop << ", " << entry.bytes / 1024 << " KiB" << std::endl;
+    }
+
+    // starts decoding the nearest visible texture that is below what it needs, if its full size fits into room
+    void startReload(size_t room)
+    {
+        Entry *nearest = nullptr;
+        for (auto &entry : entries)
+        {
+            Entry &candidate = entry.second;
+            if (!visible(candidate) || candidate.dropped == 0 || neededDrop(candidate) >= candidate.dropped)
+                continue;
+            if (candidate.fullBytes - candidate.bytes > room)
+                continue;
+            if (!nearest || candidate.distance < nearest->distance)
+                nearest = &candidate;
+        }
+        if (!nearest)
+            return;
+        reloadID = nearest->id;
+        reload = ImageDecoder::decodeAsync(nearest->path);
+    }
+
+    void finishReload()
+    {
+        if (!reload.valid() || reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        DecodedImage image = reload.get();
+        auto found = entries.find(reloadID);
+        // the texture may have been deleted meanwhile
+        if (found == entries.end() || !image.valid())
+            return;
+
+        Entry &entry = found->second;
+        SpecifyTexture(entry.id, image);
+        FinishTexture(entry.id, image, entry.clampAlpha);
+        entry.dropped = 0;
+        entry.bytes = TextureBytes(image);
+        std::cout << "TEXTURE_RESIDENCY::RELOADED " << entry.path << ", " << entry.bytes / 1024 << " KiB" << std::endl;
+    }
+};
+
+#endif
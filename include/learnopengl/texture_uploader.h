@@ -0,0 +1,299 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/image_decoder.h>
+#include <learnopengl/load_profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <list>
+#include <vector>
+
+// Streams texture data to the GPU through a ring of pixel buffer objects, a few slices per frame, never waiting on
+// a slot still in flight. GL thread only.
+class TextureUploader
+{
+public:
+    typedef std::function<void(const DecodedImage &image)> Callback;
+
+    static TextureUploader &instance()
+    {
+        static TextureUploader uploader;
+        return uploader;
+    }
+
+    explicit TextureUploader(unsigned int slotCount = 4, size_t slotSize = 4 << 20) : slotSize(slotSize), slots(slotCount)
+    {
+    }
+
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader &operator=(const TextureUploader&) = delete;
+
+    // uploads image into level 0 (all baked levels for compressed images) of target, which is GL_TEXTURE_2D or a cube
+    // map face of texture. The storage is (re)specified to fit the image when its first slice goes out.
+    void enqueue(unsigned int texture, GLenum target, std::future<DecodedImage> image, Callback done = Callback())
+    {
+        Upload upload;
+        upload.texture = texture;
+        upload.target = target;
+        upload.decoding = std::move(image);
+        upload.done = std::move(done);
+        uploads.push_back(std::move(upload));
+    }
+
+    void enqueue(unsigned int texture, GLenum target, DecodedImage image, Callback done = Callback())
+    {
+        std::promise<DecodedImage> decoded;
+        decoded.set_value(std::move(image));
+        enqueue(texture, target, decoded.get_future(), std::move(done));
+    }
+
+    bool busy() const
+    {
+        return !uploads.empty();
+    }
+
+    // sends slices for about budgetMs milliseconds, at least one if a slot is free. Call once per frame.
+    void update(double budgetMs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!uploads.empty())
+        {
+            std::list<Upload>::iterator upload = nextReady(false);
+            if (upload == uploads.end() || !sendSlice(*upload, false))
+                return;
+            if (upload->finished)
+                complete(upload);
+
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= budgetMs)
+                return;
+        }
+    }
+
+    // everything that is queued, waiting for decodes and slots as needed
+    void finish()
+    {
+        while (!uploads.empty())
+        {
+            std::list<Upload>::iterator upload = nextReady(true);
+            sendSlice(*upload, true);
+            if (upload->finished)
+                complete(upload);
+        }
+    }
+
+    size_t uploadedBytes() const
+    {
+        return bytesSent;
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        GLsync fence = 0;
+    };
+
+    struct Upload {
+        unsigned int texture;
+        GLenum target;
+        std::future<DecodedImage> decoding;
+        DecodedImage image;
+        bool decoded = false;
+        bool started = false;
+        bool finished = false;
+        // next level and row (in pixels) to send
+        unsigned int level = 0;
+        int row = 0;
+        // time spent sending slices and what they added up to, for the LoadProfiler
+        double ms = 0.0;
+        size_t bytes = 0;
+        Callback done;
+    };
+
+    size_t slotSize;
+    std::vector<Slot> slots;
+    unsigned int nextSlot = 0;
+    std::list<Upload> uploads;
+    size_t bytesSent = 0;
+
+    // first upload (in queue order) whose image is decoded
+    std::list<Upload>::iterator nextReady(bool wait)
+    {
+        for (std::list<Upload>::iterator upload = uploads.begin(); upload != uploads.end(); ++upload)
+        {
+            if (!upload->decoded && (wait || upload->decoding.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+            {
+                upload->image = upload->decoding.get();
+                upload->decoded = true;
+            }
+            if (upload->decoded)
+                return upload;
+        }
+        return uploads.end();
+    }
+
+    Slot *freeSlot(bool wait)
+    {
+        Slot &slot = slots[nextSlot];
+        if (slot.buffer == 0)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slotSize, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (slot.fence)
+        {
+            GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+            if (status == GL_TIMEOUT_EXPIRED && !wait)
+                return nullptr;  // the GPU still reads from the oldest slot, so the whole ring is busy
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        nextSlot = (nextSlot + 1) % slots.size();
+        return &slot;
+    }
+
+    static GLenum bindingTarget(GLenum target)
+    {
+        return target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+    }
+
+    // storage for every level the image brings, contents follow slice by slice
+    static void allocate(const Upload &upload)
+    {
+        const DecodedImage &image = upload.image;
+        glBindTexture(bindingTarget(upload.target), upload.texture);
+        if (image.isCompressed())
+        {
+            for (unsigned int i = 0; i < image.compressed.levels.size(); i++)
+            {
+                const CompressedLevel &level = image.compressed.levels[i];
+                glCompressedTexImage2D(upload.target, i, image.compressed.glFormat, level.width, level.height, 0, (GLsizei)level.size, nullptr);
+            }
+        }
+        else
+        {
+            GLenum format = image.pixelFormat();
+            glTexImage2D(upload.target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    // copies the next slice of upload into a PBO slot and starts its transfer. False if no slot was free.
+    bool sendSlice(Upload &upload, bool wait)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const DecodedImage &image = upload.image;
+        if (!image.valid())
+        {
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            upload.finished = true;
+            return true;
+        }
+        if (!image.isCompressed() && image.pixelFormat() == 0)
+        {
+            std::cout << "ERROR::TEXTURE::UNSUPPORTED_CHANNEL_COUNT " << image.components << " in " << image.path << std::endl;
+            upload.finished = true;
+            return true;
+        }
+
+        // what the slice covers: whole rows of pixels, or of 4x4 blocks
+        int width, height, rowsPerLine;
+        size_t lineBytes;
+        const unsigned char *source;
+        if (image.isCompressed())
+        {
+            const CompressedLevel &level = image.compressed.levels[upload.level];
+            width = level.width;
+            height = level.height;
+            rowsPerLine = 4;
+            lineBytes = level.size / std::max(1, (height + 3) / 4);
+            source = level.data;
+        }
+        else
+        {
+            width = image.width;
+            height = image.height;
+            rowsPerLine = 1;
+            lineBytes = (size_t)width * image.components;
+            source = image.pixels;
+        }
+        int lineCount = std::max(1, (int)(slotSize / lineBytes));
+        int firstLine = upload.row / rowsPerLine;
+        int lastLine = std::min((height + rowsPerLine - 1) / rowsPerLine, firstLine + lineCount);
+        int rows = std::min(height - upload.row, (lastLine - firstLine) * rowsPerLine);
+        size_t bytes = (lastLine - firstLine) * lineBytes;
+        const unsigned char *data = source + firstLine * lineBytes;
+
+        Slot *slot = nullptr;
+        if (bytes <= slotSize)
+        {
+            slot = freeSlot(wait);
+            if (!slot)
+                return false;
+        }
+
+        if (!upload.started)
+        {
+            allocate(upload);
+            upload.started = true;
+        }
+
+        if (slot)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+            // invalidating lets the driver hand out fresh memory instead of syncing, the fence covers the rest
+            void *memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            memcpy(memory, data, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            data = nullptr;  // from here on an offset into the bound buffer
+        }
+
+        // a single line that doesn't fit a slot goes straight from client memory
+        glBindTexture(bindingTarget(upload.target), upload.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (image.isCompressed())
+            glCompressedTexSubImage2D(upload.target, upload.level, 0, upload.row, width, rows, image.compressed.glFormat, (GLsizei)bytes, data);
+        else
+            glTexSubImage2D(upload.target, 0, 0, upload.row, width, rows, image.pixelFormat(), GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if (slot)
+        {
+            slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        bytesSent += bytes;
+        upload.bytes += bytes;
+
+        upload.row += rows;
+        if (upload.row >= height)
+        {
+            upload.row = 0;
+            upload.level++;
+            upload.finished = !image.isCompressed() || upload.level >= image.compressed.levels.size();
+        }
+        upload.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    void complete(std::list<Upload>::iterator upload)
+    {
+        // off the queue first, done may well enqueue more
+        Upload finished = std::move(*upload);
+        uploads.erase(upload);
+        if (finished.image.valid())
+            LoadProfiler::instance().record(LoadProfiler::assetOf(finished.image.path), "upload", finished.ms, finished.bytes);
+        if (finished.done)
+            finished.done(finished.image);
+    }
+};
+
+#endif
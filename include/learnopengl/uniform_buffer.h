@@ -0,0 +1,71 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// One uniform block in a buffer attached to a binding point. Block mirrors the std140 layout with explicit padding,
+// update() only uploads what differs from the last upload.
+template<typename Block>
+class UniformBuffer
+{
+public:
+    // needs the GL context, creates the buffer and attaches it to binding
+    UniformBuffer(const std::string &name, GLuint binding)
+        : name(name), binding(binding)
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer &operator=(const UniformBuffer&) = delete;
+
+    // uploads data unless it is what the buffer holds already, true if it did
+    bool update(const Block &data)
+    {
+        updates++;
+        if (uploads > 0 && memcmp(&data, &last, sizeof(Block)) == 0)
+            return false;
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        last = data;
+        uploads++;
+        return true;
+    }
+
+    GLuint bindingPoint() const
+    {
+        return binding;
+    }
+
+    void deleteBuffer()
+    {
+        glDeleteBuffers(1, &UBO);
+        UBO = 0;
+    }
+
+    void printReport() const
+    {
+        if (updates == 0)
+            return;
+        std::cout << "UNIFORM_BUFFER:: " << name << " (" << sizeof(Block) << " bytes) uploaded " << uploads << " of "
+                  << updates << " updates" << std::endl;
+    }
+
+private:
+    std::string name;
+    GLuint binding;
+    unsigned int UBO = 0;
+    Block last = Block();
+    size_t updates = 0, uploads = 0;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a uniform's name, kept as its hash. The compiler hashes literals wherever the name is a constant expression, e.g.
+//   static constexpr UniformName model("model");
+// and in practice in every optimized build; std::strings are hashed at run time, without a copy.
+struct UniformName {
+    uint64_t hash;
+
+    constexpr UniformName(const char *name) : hash(hashLiteral(name)) {}
+    UniformName(const std::string &name) : hash(hashString(name)) {}
+    // a hash computed elsewhere, e.g. chained from a prefix with hashString(suffix, hashString(prefix))
+    explicit constexpr UniformName(uint64_t hash) : hash(hash) {}
+};
+
+// a uniform's location, looked up once with Shader::uniform and handed to the setters as is
+struct UniformHandle {
+    GLint location;
+};
+
+// The active uniform locations of a program by name hash, arrays also as "name" and every "name[i]". Open
+// addressing with linear probing.
+class UniformTable
+{
+public:
+    void reflect(GLuint program)
+    {
+        entries.assign(MIN_CAPACITY, Entry());
+        count = 0;
+        done = true;
+
+        GLint active = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < active; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue;
+            insert(hashString(name), location);
+
+            bool indexed = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            if (!indexed && size <= 1)
+                continue;
+            std::string base = indexed ? name.substr(0, name.size() - 3) : name;
+            insert(hashString(base), location);
+            for (GLint element = 0; element < size; element++)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                GLint elementLocation = element == 0 ? location : glGetUniformLocation(program, elementName.c_str());
+                if (elementLocation >= 0)
+                    insert(hashString(elementName), elementLocation);
+            }
+        }
+    }
+
+    bool reflected() const
+    {
+        return done;
+    }
+
+    // -1 for names the program has no active uniform for, which glUniform* quietly ignores
+    GLint location(UniformName name) const
+    {
+        if (entries.empty())
+            return -1;
+        size_t mask = entries.size() - 1;
+        for (size_t slot = name.hash & mask; ; slot = (slot + 1) & mask)
+        {
+            const Entry &entry = entries[slot];
+            if (entry.location < 0 || entry.hash == name.hash)
+                return entry.location;
+        }
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    static const size_t MIN_CAPACITY = 16;
+
+    struct Entry {
+        uint64_t hash = 0;
+        // -1 marks an empty slot
+        GLint location = -1;
+    };
+
+    std::vector<Entry> entries;
+    size_t count = 0;
+    bool done = false;
+
+    void insert(uint64_t hash, GLint location)
+    {
+        if ((count + 1) * 2 > entries.size())
+        {
+            std::vector<Entry> old;
+            old.swap(entries);
+            entries.assign(old.size() * 2, Entry());
+            count = 0;
+            for (const Entry &entry : old)
+                if (entry.location >= 0)
+                    insert(entry.hash, entry.location);
+        }
+        size_t mask = entries.size() - 1;
+        size_t slot = hash & mask;
+        while (entries[slot].location >= 0 && entries[slot].hash != hash)
+            slot = (slot + 1) & mask;
+        if (entries[slot].location < 0)
+            count++;
+        entries[slot].hash = hash;
+        entries[slot].location = location;
+    }
+};
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Vertex formats described by types: AttributeTraits say how glVertexAttribPointer reads an attribute type,
+// VertexFormat lists a vertex struct's attributes, setVertexAttributes<V>() sets up the bound VAO.
+
+// how the GL reads one attribute of type T
+template<typename T> struct AttributeTraits;
+
+template<> struct AttributeTraits<glm::vec2> {
+    static const GLint components = 2;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+};
+
+template<> struct AttributeTraits<glm::vec3> {
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+};
+
+// position quantized to 16 bits per axis over the bounding box of its mesh, see PositionQuantization.
+// The shader gets the raw integers as floats, w is padding to keep the attribute 4 byte aligned.
+struct QuantizedPosition {
+    uint16_t x, y, z, w;
+};
+
+template<> struct AttributeTraits<QuantizedPosition> {
+    static const GLint components = 3;
+    static const GLenum type = GL_UNSIGNED_SHORT;
+    static const GLboolean normalized = GL_FALSE;
+};
+
+// unit vector folded onto an octahedron and stored as two snorm16, decoded in the shader (octDecode)
+struct OctahedralNormal {
+    int16_t x, y;
+};
+
+template<> struct AttributeTraits<OctahedralNormal> {
+    static const GLint components = 2;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+};
+
+// two half floats
+struct HalfTexCoords {
+    uint16_t u, v;
+};
+
+template<> struct AttributeTraits<HalfTexCoords> {
+    static const GLint components = 2;
+    static const GLenum type = GL_HALF_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+};
+
+// the whole tangent frame as a unit quaternion in snorm16 (xyzw). It rotates the tangent space axes onto
+// tangent, bitangent and normal; w is never zero and its sign says whether the bitangent is mirrored:
+//   tangent   = (1 - 2(y² + z²), 2(xy + wz), 2(xz - wy))
+//   normal    = (2(xz + wy), 2(yz - wx), 1 - 2(x² + y²))
+//   bitangent = cross(normal, tangent) * sign(w)
+struct QTangent {
+    int16_t x, y, z, w;
+};
+
+template<> struct AttributeTraits<QTangent> {
+    static const GLint components = 4;
+    static const GLenum type = GL_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+};
+
+// one attribute of a vertex struct, ready for glVertexAttribPointer
+struct VertexAttribute {
+    GLuint    location;
+    GLint     components;
+    GLenum    type;
+    GLboolean normalized;
+    size_t    offset;
+};
+
+// the attribute member of vertex struct V, to be read at shader location location
+template<typename V, typename A>
+VertexAttribute vertexAttribute(GLuint location, A V::*member)
+{
+    static const V probe = V();
+    size_t offset = reinterpret_cast<const char*>(&(probe.*member)) - reinterpret_cast<const char*>(&probe);
+    return VertexAttribute{ location, AttributeTraits<A>::components, AttributeTraits<A>::type, AttributeTraits<A>::normalized, offset };
+}
+
+// the attributes of vertex struct V, specialized for every vertex struct that gets uploaded
+template<typename V> struct VertexFormat;
+
+// points the bound VAO's attributes at the bound GL_ARRAY_BUFFER, which holds V's. Attributes outside
+// enabledLocations (a bit per location) are set up but left disabled, see Shader::attributeMask.
+template<typename V>
+void setVertexAttributes(unsigned int enabledLocations = ~0u)
+{
+    for (const VertexAttribute &attribute : VertexFormat<V>::attributes())
+    {
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, sizeof(V),
+                              (void*)attribute.offset);
+        if (enabledLocations & (1u << attribute.location))
+            glEnableVertexAttribArray(attribute.location);
+        else
+            glDisableVertexAttribArray(attribute.location);
+    }
+}
+
+// what meshes upload: 24 bytes a vertex where Vertex takes 56
+struct PackedVertex {
+    QuantizedPosition Position;
+    OctahedralNormal  Normal;
+    HalfTexCoords     TexCoords;
+    QTangent          TangentFrame;
+};
+
+template<> struct VertexFormat<PackedVertex> {
+    static const std::vector<VertexAttribute> &attributes()
+    {
+        static const std::vector<VertexAttribute> list = {
+            vertexAttribute(0, &PackedVertex::Position),
+            vertexAttribute(1, &PackedVertex::Normal),
+            vertexAttribute(2, &PackedVertex::TexCoords),
+            vertexAttribute(3, &PackedVertex::TangentFrame),
+        };
+        return list;
+    }
+};
+
+// how the 16 bit positions of one mesh map back to model space: position = offset + quantized * scale
+struct PositionQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    static PositionQuantization fromBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        PositionQuantization quantization;
+        quantization.offset = boundsMin;
+        glm::vec3 extent = boundsMax - boundsMin;
+        for (int i = 0; i < 3; i++)
+            quantization.scale[i] = extent[i] > 0.0f ? extent[i] / 65535.0f : 1.0f;
+        return quantization;
+    }
+
+    QuantizedPosition quantize(const glm::vec3 &position) const
+    {
+        QuantizedPosition quantized;
+        uint16_t *axes[3] = { &quantized.x, &quantized.y, &quantized.z };
+        for (int i = 0; i < 3; i++)
+            *axes[i] = (uint16_t)std::min(65535.0f, std::max(0.0f, std::round((position[i] - offset[i]) / scale[i])));
+        quantized.w = 0;
+        return quantized;
+    }
+};
+
+inline int16_t packSnorm16(float value)
+{
+    return (int16_t)std::round(std::min(1.0f, std::max(-1.0f, value)) * 32767.0f);
+}
+
+// IEEE 754 binary16, rounded to nearest even. Out of range values become infinity, tiny ones denormals or zero.
+inline uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff)
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    int halfExponent = (int)exponent - 127 + 15;
+    if (halfExponent >= 31)
+        return (uint16_t)(sign | 0x7c00);
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+            return (uint16_t)sign;
+        // denormal: the implicit one becomes explicit and everything shifts right
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return (uint16_t)half;
+}
+
+inline OctahedralNormal packOctahedral(const glm::vec3 &normal)
+{
+    float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (sum == 0.0f)
+        return OctahedralNormal{ 0, 0 };
+    float x = normal.x / sum, y = normal.y / sum;
+    // the lower half folds over the diagonals onto the outer triangles
+    if (normal.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return OctahedralNormal{ packSnorm16(x), packSnorm16(y) };
+}
+
+inline QTangent packQTangent(const glm::vec3 &tangent, const glm::vec3 &bitangent, const glm::vec3 &normal)
+{
+    // orthonormal frame around the normal, with the tangent as close to the given one as possible
+    glm::vec3 n = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 t = tangent - n * glm::dot(n, tangent);
+    if (glm::length(t) < 1e-6f)
+        t = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, glm::vec3(0.0f, 1.0f, 0.0f));
+    t = glm::normalize(t);
+    glm::vec3 b = glm::cross(n, t);
+    bool mirrored = glm::dot(b, bitangent) < 0.0f;
+
+    // rotation matrix with columns t, b, n to quaternion
+    float q[4];  // x y z w
+    float trace = t.x + b.y + n.z;
+    if (trace > 0.0f)
+    {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        q[3] = 0.25f * s;
+        q[0] = (b.z - n.y) / s;
+        q[1] = (n.x - t.z) / s;
+        q[2] = (t.y - b.x) / s;
+    }
+    else if (t.x > b.y && t.x > n.z)
+    {
+        float s = std::sqrt(1.0f + t.x - b.y - n.z) * 2.0f;
+        q[3] = (b.z - n.y) / s;
+        q[0] = 0.25f * s;
+        q[1] = (b.x + t.y) / s;
+        q[2] = (n.x + t.z) / s;
+    }
+    else if (b.y > n.z)
+    {
+        float s = std::sqrt(1.0f + b.y - t.x - n.z) * 2.0f;
+        q[3] = (n.x - t.z) / s;
+        q[0] = (b.x + t.y) / s;
+        q[1] = 0.25f * s;
+        q[2] = (n.y + b.z) / s;
+    }
+    else
+    {
+        float s = std::sqrt(1.0f + n.z - t.x - b.y) * 2.0f;
+        q[3] = (t.y - b.x) / s;
+        q[0] = (n.x + t.z) / s;
+        q[1] = (n.y + b.z) / s;
+        q[2] = 0.25f * s;
+    }
+
+    // q and -q are the same rotation: make w positive, and big enough that snorm16 can't round it to zero,
+    // then let its sign carry the mirroring
+    if (q[3] < 0.0f)
+        for (float &component : q)
+            component = -component;
+    const float bias = 1.0f / 32767.0f;
+    if (q[3] < bias)
+    {
+        float factor = std::sqrt(1.0f - bias * bias) / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+        q[0] *= factor;
+        q[1] *= factor;
+        q[2] *= factor;
+        q[3] = bias;
+    }
+    if (mirrored)
+        for (float &component : q)
+            component = -component;
+    return QTangent{ packSnorm16(q[0]), packSnorm16(q[1]), packSnorm16(q[2]), packSnorm16(q[3]) };
+}
+
+#endif
@@ -12,18 +12,32 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/uniform_table.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    // filled once linked, see UniformTable
+    mutable UniformTable m_Uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
         appendShaderFolderIfNotPresent(fragmentShaderPath);
         // build and compile our shader program
         // ------------------------------------
-        // vertex shader
         std::string vsString = readFileContents(vertexShaderPath);
         ASSERT(!vsString.empty(), "Vertex shader source is empty!");
+        std::string fsString = readFileContents(fragmentShaderPath);
+        ASSERT(!fsString.empty(), "Fragment shader empty!");
+        // program binary of an earlier run, if the driver still accepts it
+        uint64_t programKey = ProgramCache::key({ vsString, fsString });
+        int shaderProgram = glCreateProgram();
+        if (ProgramCache::load(shaderProgram, programKey)) {
+            m_Id = shaderProgram;
+            m_Uniforms.reflect(m_Id);
+            return;
+        }
+        // vertex shader
         const char* vertexShaderSource = vsString.c_str();
         int vertexShader = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -39,8 +53,6 @@ public:
         }
         // fragment shader
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        std::string fsString = readFileContents(fragmentShaderPath);
-        ASSERT(!fsString.empty(), "Fragment shader empty!");
         const char* fragmentShaderSource = fsString.c_str();
         glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
         glCompileShader(fragmentShader);
@@ -52,15 +64,18 @@ public:
             std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
         }
         // link shaders
-        int shaderProgram = glCreateProgram();
         glAttachShader(shaderProgram, vertexShader);
         glAttachShader(shaderProgram, fragmentShader);
+        ProgramCache::prepare(shaderProgram);
         glLinkProgram(shaderProgram);
         // check for linking errors
         glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
             std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        } else {
+            ProgramCache::store(shaderProgram, programKey);
+            m_Uniforms.reflect(shaderProgram);
         }
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
@@ -73,67 +88,113 @@ public:
     {
         glUseProgram(m_Id);
     }
-    // utility uniform functions
+    // the location of a uniform, -1 if the program has no such active uniform. Look up the ones set every frame once
+    // and pass the handle to the setters, which then skip even the hash table.
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    UniformHandle uniform(UniformName name) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        if (!m_Uniforms.reflected())
+            m_Uniforms.reflect(m_Id);
+        return UniformHandle{ m_Uniforms.location(name) };
     }
+    // utility uniform functions, by name (hashed, see UniformName) or by handle
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setBool(UniformName name, bool value) const
+    {
+        setBool(uniform(name), value);
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformName name, int value) const
+    {
+        setInt(uniform(name), value);
+    }
+    void setInt(UniformHandle handle, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1i(handle.location, value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value) const
+    {
+        setFloat(uniform(name), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1f(handle.location, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value) const
+    {
+        setVec2(uniform(name), value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform2fv(handle.location, 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(uniform(name).location, x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value) const
+    {
+        setVec3(uniform(name), value);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform3fv(handle.location, 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(uniform(name).location, x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec4(uniform(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void setVec4(UniformName name, float x, float y, float z, float w) const
+    {
+        glUniform4f(uniform(name).location, x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat) const
+    {
+        setMat2(uniform(name), mat);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat) const
+    {
+        setMat4(uniform(name), mat);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
         m_Id = 0;
+        m_Uniforms = UniformTable();
     }
 
 
@@ -24,7 +24,11 @@ struct DirLight {
 };
 
 uniform sampler2D texture1;
-uniform vec3 viewPosition;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 uniform PointLight pointLight;
 uniform DirLight dirLight;
 
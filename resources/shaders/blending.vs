@@ -1,17 +1,36 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
+// per grass clump: position and scale, and how many turned copies of the quad it is made of
+layout (location = 2) in vec4 aClump;
+layout (location = 3) in float aRotations;
 
 out vec2 TexCoords;
 out vec3 FragPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    // the vertex buffer holds the quad once per copy, six vertices each
+    int quad = gl_VertexID / 6;
+    if (float(quad) >= aRotations)
+    {
+        // copies the clump doesn't have collapse to a point and get culled
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        TexCoords = aTexCoords;
+        FragPos = aClump.xyz;
+        return;
+    }
+    // centered on the clump and turned about the y axis, the copies spread evenly around the full circle
+    float angle = radians(360.0) * float(quad) / aRotations;
+    vec3 local = aPos - vec3(0.5, 0.0, 0.0);
+    vec3 turned = vec3(cos(angle) * local.x + sin(angle) * local.z, local.y, -sin(angle) * local.x + cos(angle) * local.z);
+    FragPos = aClump.xyz + aClump.w * turned;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -2,16 +2,15 @@
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
+// the light structs are laid out for std140, each vec3 followed by the float that fills its last four bytes
 struct PointLight {
     vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct DirLight {
@@ -24,17 +23,16 @@ struct DirLight {
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
 
-    float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
 };
 
 struct Material {
@@ -47,13 +45,21 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight pointLight;
-uniform DirLight dirLight;
 uniform Material material;
-uniform SpotLight spotLight;
-uniform SpotLight spotLight1;
 
-uniform vec3 viewPosition;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+// only updated when a light changes
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirLight dirLight;
+    SpotLight spotLight;
+    SpotLight spotLight1;
+};
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
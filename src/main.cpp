@@ -13,8 +13,12 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/scene_loader.h>
+#include <learnopengl/uniform_buffer.h>
 
+#include <cstddef>
 #include <iostream>
+#include <thread>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -62,6 +66,16 @@ struct DirLight {
     glm::vec3 specular;
 };
 
+// one clump of grass, drawn as rotations copies of the grass quad turned about its center (see blending.vs)
+struct GrassClump {
+    glm::vec3 position;
+    float scale;
+    float rotations;
+};
+
+// most quads a clump can have, the grass VAO holds the quad this many times over
+const unsigned int MAX_GRASS_QUADS = 12;
+
 struct SpotLight {
     glm::vec3 position;
     glm::vec3 direction;
@@ -77,6 +91,64 @@ struct SpotLight {
     glm::vec3 specular;
 };
 
+// binding points of the uniform blocks every program shares
+const GLuint CAMERA_BINDING = 0;
+const GLuint LIGHTS_BINDING = 1;
+
+// the Camera block of the shaders in std140 layout
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match std140");
+
+// the Lights block of model_lighting.fs in std140 layout: every struct starts on 16 bytes, and so does every vec3,
+// which is why the GLSL structs put a float after each of them
+struct PointLightBlock {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct DirLightBlock {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float cutOff;
+    glm::vec3 direction;
+    float outerCutOff;
+    glm::vec3 ambient;
+    float constant;
+    glm::vec3 diffuse;
+    float linear;
+    glm::vec3 specular;
+    float quadratic;
+};
+
+struct LightsBlock {
+    PointLightBlock pointLight;
+    DirLightBlock dirLight;
+    SpotLightBlock spotLight;
+    SpotLightBlock spotLight1;
+};
+static_assert(sizeof(LightsBlock) == 288, "LightsBlock must match std140");
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -153,8 +225,43 @@ struct ProgramState {
     void SaveToFile(std::string filename);
 
     void LoadFromFile(std::string filename);
+
+    // the lights as the Lights uniform block holds them
+    LightsBlock lightsBlock() const;
 };
 
+LightsBlock ProgramState::lightsBlock() const {
+    LightsBlock block = LightsBlock();
+    block.pointLight.position = pointLight.position;
+    block.pointLight.ambient = pointLight.ambient;
+    block.pointLight.diffuse = pointLight.diffuse;
+    block.pointLight.specular = pointLight.specular;
+    block.pointLight.constant = pointLight.constant;
+    block.pointLight.linear = pointLight.linear;
+    block.pointLight.quadratic = pointLight.quadratic;
+
+    block.dirLight.direction = dirLight.direction;
+    block.dirLight.ambient = dirLight.ambient;
+    block.dirLight.diffuse = dirLight.diffuse;
+    block.dirLight.specular = dirLight.specular;
+
+    SpotLightBlock *spots[] = { &block.spotLight, &block.spotLight1 };
+    const SpotLight *lights[] = { &spotLight, &spotLight1 };
+    for (int i = 0; i < 2; i++) {
+        spots[i]->position = lights[i]->position;
+        spots[i]->direction = lights[i]->direction;
+        spots[i]->cutOff = lights[i]->cutOff;
+        spots[i]->outerCutOff = lights[i]->outerCutOff;
+        spots[i]->ambient = lights[i]->ambient;
+        spots[i]->diffuse = lights[i]->diffuse;
+        spots[i]->specular = lights[i]->specular;
+        spots[i]->constant = lights[i]->constant;
+        spots[i]->linear = lights[i]->linear;
+        spots[i]->quadratic = lights[i]->quadratic;
+    }
+    return block;
+}
+
 void ProgramState::SaveToFile(std::string filename) {
     std::ofstream out(filename);
     out << clearColor.r << '\n'
@@ -230,6 +337,15 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // linked shader binaries from earlier runs, LOGL_NO_PROGRAM_CACHE=1 to always compile from source
+    ProgramCache::init((GLADloadproc) glfwGetProcAddress);
+    // let the driver compile the programs below on its own threads, LOGL_SYNC_SHADERS=1 for one after the other
+    ParallelCompile::init((GLADloadproc) glfwGetProcAddress);
+    // read resources/ out of the pack the asset_bake target writes where there is one, LOGL_NO_ASSET_PACK=1 for loose files only
+    if (getenv("LOGL_NO_ASSET_PACK") == nullptr)
+        Assets::mount(FileSystem::getPath("resources/assets.pack"), FileSystem::getPath(""));
+    // use the textures baked by bake_textures where the driver takes them, LOGL_NO_COMPRESSED_TEXTURES=1 to compare
+    ImageDecoder::setPreferCompressed(getenv("LOGL_NO_COMPRESSED_TEXTURES") == nullptr && BlockCompressionSupported());
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -251,6 +367,8 @@ int main() {
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
+    // filter across cube map face edges, the skybox's smaller mips would show the seams otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // enable face culling
     glEnable(GL_CULL_FACE);
@@ -259,12 +377,13 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader blendingShader("resources/shaders/blending.vs", "resources/shaders/blending.fs");
-    Shader hdrShader("resources/shaders/hdrShader.vs", "resources/shaders/hdrShader.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-    Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
+    // all submitted up front, the driver works on them while the models load and they're finished further down
+    Shader ourShader = Shader::submit("resources/shaders/model_lighting.vs", "resources/shaders/model_lighting.fs");
+    Shader skyboxShader = Shader::submit("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+    Shader blendingShader = Shader::submit("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    Shader hdrShader = Shader::submit("resources/shaders/hdrShader.vs", "resources/shaders/hdrShader.fs");
+    Shader blurShader = Shader::submit("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    Shader bloomShader = Shader::submit("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
 
     float skyboxVertices[] = {
             // positions
@@ -332,52 +451,71 @@ int main() {
 
     // load models
     // -----------
-    Model fieldModel("resources/objects/field_and_garden/scene.gltf");
+    // models load in the background, nearest to the camera first, and show up as soon as they are on the GPU.
+    // LOGL_SYNC_LOADING=1 loads everything up front instead.
+    SceneLoader sceneLoader(getenv("LOGL_SYNC_LOADING") == nullptr);
+    sceneLoader.setViewerPosition(programState->camera.Position);
+    // time per frame the TextureUploader may spend pushing texture data to the GPU
+    double textureUploadBudgetMs = getenv("LOGL_UPLOAD_BUDGET_MS") ? atof(getenv("LOGL_UPLOAD_BUDGET_MS")) : 2.0;
+
+    Model fieldModel;
     fieldModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(fieldModel, "resources/objects/field_and_garden/scene.gltf", programState->fieldPosition);
 
     // corn model
-    Model cornModel("resources/objects/corn_corn_corn/scene.gltf");
+    Model cornModel;
     cornModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(cornModel, "resources/objects/corn_corn_corn/scene.gltf", programState->cornPosition);
 
     // hay bale model
-    Model hayModel("resources/objects/hay_bale/scene.gltf");
+    Model hayModel;
     hayModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(hayModel, "resources/objects/hay_bale/scene.gltf", programState->hayPosition);
 
     // tractor model
-    Model tractorModel("resources/objects/New_holland_T7_Tractor_SF/New_holland_T7_Tractor_SF.obj");
+    Model tractorModel;
     tractorModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(tractorModel, "resources/objects/New_holland_T7_Tractor_SF/New_holland_T7_Tractor_SF.obj", programState->tractorPosition);
 
     // cabin model
-    Model cabinModel("resources/objects/barn/scene.gltf");
+    Model cabinModel;
     cabinModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(cabinModel, "resources/objects/barn/scene.gltf", programState->cabinPosition);
 
     // hay pile model
-    Model hayPileModel("resources/objects/small_garden_hay/scene.gltf");
+    Model hayPileModel;
     hayPileModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(hayPileModel, "resources/objects/small_garden_hay/scene.gltf", programState->hayPilePosition);
 
     // fence model
-    Model fenceModel("resources/objects/fence_wood/scene.gltf");
+    Model fenceModel;
     fenceModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(fenceModel, "resources/objects/fence_wood/scene.gltf", programState->fencePosition);
 
     // gate model
-    Model gateModel("resources/objects/gate_wood/scene.gltf");
+    Model gateModel;
     gateModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(gateModel, "resources/objects/gate_wood/scene.gltf", programState->gatePosition);
 
     // water bowl model
-    Model waterBowlModel("resources/objects/water_bowl/scene.gltf");
+    Model waterBowlModel;
     waterBowlModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(waterBowlModel, "resources/objects/water_bowl/scene.gltf", programState->waterBowlPosition);
 
     // sheep model
-    Model sheepModel("resources/objects/sheep/scene.gltf");
+    Model sheepModel;
     sheepModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(sheepModel, "resources/objects/sheep/scene.gltf", programState->sheepPosition);
 
     // water tower model
-    Model waterTowerModel("resources/objects/old_water_tower/scene.gltf");
+    Model waterTowerModel;
     waterTowerModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(waterTowerModel, "resources/objects/old_water_tower/scene.gltf", programState->waterTowerPosition);
 
     // wall lamp model
-    Model lampModel("resources/objects/wall_lamp/scene.gltf");
+    Model lampModel;
     lampModel.SetShaderTextureNamePrefix("material.");
+    sceneLoader.load(lampModel, "resources/objects/wall_lamp/scene.gltf", programState->lampPosition);
 
     // Point light
     PointLight& pointLight = programState->pointLight;
@@ -417,6 +555,9 @@ int main() {
     spotLight1.quadratic = 0.032f;
     spotLight1.cutOff = glm::cos(glm::radians(12.5f));
     spotLight1.outerCutOff = glm::cos(glm::radians(17.5f));
+    // the tractor's headlights, their positions follow it
+    spotLight.direction = glm::vec3(-0.17f, -0.3f, 1.0f);
+    spotLight1.direction = glm::vec3(-0.03f, -0.3f, 1.0f);
 
     // configure floating point framebuffer
     // ------------------------------------
@@ -485,7 +626,11 @@ int main() {
     glGenBuffers(1, &transparentVBO);
     glBindVertexArray(transparentVAO);
     glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
+    // the quad once per copy a clump can have, blending.vs tells them apart by gl_VertexID
+    vector<float> grassQuads;
+    for (unsigned int i = 0; i < MAX_GRASS_QUADS; i++)
+        grassQuads.insert(grassQuads.end(), std::begin(transparentVertices), std::end(transparentVertices));
+    glBufferData(GL_ARRAY_BUFFER, grassQuads.size() * sizeof(float), grassQuads.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
@@ -507,7 +652,6 @@ int main() {
     unsigned int transparentTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str());
 
     // skybox textures
-    stbi_set_flip_vertically_on_load(false);
     vector<std::string> faces
             {
                     FileSystem::getPath("resources/textures/skybox/right.jpg"),
@@ -544,12 +688,61 @@ int main() {
                     glm::vec3(11.91f, 1.17f, -13.76f),
             };
 
+    // grass instances, one clump per vegetation position
+    vector<GrassClump> grassClumps;
+    for (const glm::vec3 &position : vegetation)
+        grassClumps.push_back(GrassClump{ position, 0.3f, (float)MAX_GRASS_QUADS });
+    unsigned int grassInstanceVBO;
+    glGenBuffers(1, &grassInstanceVBO);
+    glBindVertexArray(transparentVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, grassInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, grassClumps.size() * sizeof(GrassClump), grassClumps.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(GrassClump), (void*)0);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(GrassClump), (void*)offsetof(GrassClump, rotations));
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+
+    // keep streaming the scene in until the driver is done with the programs, finishing them then doesn't wait
+    Shader *shaders[] = { &ourShader, &skyboxShader, &blendingShader, &hdrShader, &blurShader, &bloomShader };
+    auto shadersReady = [&shaders]() {
+        for (Shader *shader : shaders)
+            if (!shader->ready())
+                return false;
+        return true;
+    };
+    while (!shadersReady() && !sceneLoader.done())
+    {
+        sceneLoader.update(1.0);
+        std::this_thread::yield();
+    }
+    for (Shader *shader : shaders)
+        shader->finish();
+
     // shader configuration
+    UniformBuffer<CameraBlock> cameraBuffer("Camera", CAMERA_BINDING);
+    UniformBuffer<LightsBlock> lightsBuffer("Lights", LIGHTS_BINDING);
+    for (Shader *shader : shaders)
+    {
+        shader->bindUniformBlock("Camera", CAMERA_BINDING);
+        shader->bindUniformBlock("Lights", LIGHTS_BINDING);
+    }
+
+    ourShader.use();
+    ourShader.setFloat("material.shininess", 32.0f);
+
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
+    // the grass has a dimmer sun of its own
     blendingShader.use();
     blendingShader.setInt("texture1", 0);
+    blendingShader.setVec3("dirLight.direction", 0.35, -1.45, -1.1);
+    blendingShader.setVec3("dirLight.ambient",  0.05f, 0.05f, 0.05f);
+    blendingShader.setVec3("dirLight.diffuse", 0.25f, 0.25f, 0.25f);
+    blendingShader.setVec3("dirLight.specular", 0.3f, 0.3f, 0.3f);
 
     blurShader.use();
     blurShader.setInt("image", 0);
@@ -561,6 +754,11 @@ int main() {
     // draw in wireframe
 //    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // transforms of the corn plants, rebuilt every frame
+    vector<glm::mat4> cornInstances;
+    // the other models go through the render queue
+    RenderQueue renderQueue;
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window)) {
@@ -574,6 +772,10 @@ int main() {
         // -----
         processInput(window);
 
+        // stream in whatever finished loading in the background
+        sceneLoader.setViewerPosition(programState->camera.Position);
+        sceneLoader.update(4.0);
+        TextureUploader::instance().update(textureUploadBudgetMs);
 
         // render
         // ------
@@ -584,58 +786,24 @@ int main() {
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-
-        // Point light
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        // Directional light
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
-
-        // Spotlight
-        ourShader.setVec3("spotLight.direction", -0.17f, -0.3f, 1.0f);
-        ourShader.setVec3("spotLight.ambient", spotLight.ambient);
-        ourShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        ourShader.setVec3("spotLight.specular", spotLight.specular);
-        ourShader.setFloat("spotLight.constant", spotLight.constant);
-        ourShader.setFloat("spotLight.linear", spotLight.linear);
-        ourShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        ourShader.setFloat("spotLight.cutOff", spotLight.cutOff);
-        ourShader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-        ourShader.setVec3("spotLight.position", programState->tractorPosition + glm::vec3(0.0f, 0.9f, 2.3f));
-
-        ourShader.setVec3("spotLight1.direction", -0.03f, -0.3f, 1.0f);
-        ourShader.setVec3("spotLight1.ambient", spotLight1.ambient);
-        ourShader.setVec3("spotLight1.diffuse", spotLight1.diffuse);
-        ourShader.setVec3("spotLight1.specular", spotLight1.specular);
-        ourShader.setFloat("spotLight1.constant", spotLight1.constant);
-        ourShader.setFloat("spotLight1.linear", spotLight1.linear);
-        ourShader.setFloat("spotLight1.quadratic", spotLight1.quadratic);
-        ourShader.setFloat("spotLight1.cutOff", spotLight1.cutOff);
-        ourShader.setFloat("spotLight1.outerCutOff", spotLight1.outerCutOff);
-        ourShader.setVec3("spotLight1.position", programState->tractorPosition + glm::vec3(0.33f, 0.9f, 2.3f));
-
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        // view/projection transformations
+        // camera and lights for every program, each block is only uploaded when it changed
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
         glm::mat4 model = glm::mat4(1.0f);
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        CameraBlock cameraBlock = CameraBlock();
+        cameraBlock.projection = projection;
+        cameraBlock.view = view;
+        cameraBlock.viewPosition = programState->camera.Position;
+        cameraBuffer.update(cameraBlock);
+
+        programState->spotLight.position = programState->tractorPosition + glm::vec3(0.0f, 0.9f, 2.3f);
+        programState->spotLight1.position = programState->tractorPosition + glm::vec3(0.33f, 0.9f, 2.3f);
+        lightsBuffer.update(programState->lightsBlock());
+
+        TextureResidency::instance().beginFrame(projection, view, programState->camera.Position, SCR_HEIGHT);
+        LodSelector::instance().beginFrame(projection, programState->camera.Position, SCR_HEIGHT);
+        renderQueue.beginFrame(programState->camera.Position, 100.0f);
 
         // render the loaded models
         // field
@@ -643,12 +811,13 @@ int main() {
         model = glm::translate(model, programState->fieldPosition); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(programState->fieldScale));    // it's a bit too big for our scene, so scale it down
         model = glm::rotate(model, glm::radians(272.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fieldModel.Draw(ourShader);
+        fieldModel.UseTextures(model);
+        fieldModel.Submit(renderQueue, ourShader, model);
 
-        // corn corn corn
+        // corn corn corn, the whole field in one instanced draw per mesh
         float zRowCoord = 0.0f;
         float yRowCoord = 0.0f;
+        cornInstances.clear();
         for (int i = 0; i < 9; ++i) {
             for (int j = 0; j < 30; ++j) {
                 if (i == 8 && j > 25)
@@ -657,12 +826,15 @@ int main() {
                 model = glm::translate(model, programState->cornPosition + glm::vec3(float(j), yRowCoord, zRowCoord + j * 0.082f));
                 model = glm::scale(model, glm::vec3(programState->cornScale));
                 model = glm::rotate(model, glm::radians(275.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-                ourShader.setMat4("model", model);
-                cornModel.Draw(ourShader);
+                cornInstances.push_back(model);
             }
             zRowCoord -= 1.3f;
             yRowCoord += 0.02f;
         }
+        cornModel.UseTextures(cornInstances);
+        // don't forget to enable shader before setting uniforms
+        ourShader.use();
+        cornModel.DrawInstanced(ourShader, cornInstances);
 
         // hay bale
         model = glm::mat4(1.0f);
@@ -670,38 +842,38 @@ int main() {
         model = glm::scale(model, glm::vec3(programState->hayScale));
         model = glm::rotate(model, glm::radians(60.0f), glm::vec3(1.0f, 0.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        hayModel.Draw(ourShader);
+        hayModel.UseTextures(model);
+        hayModel.Submit(renderQueue, ourShader, model, 0);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->hay2Position);
         model = glm::scale(model, glm::vec3(programState->hayScale));
         model = glm::rotate(model, glm::radians(33.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        hayModel.Draw(ourShader);
+        hayModel.UseTextures(model);
+        hayModel.Submit(renderQueue, ourShader, model, 1);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->hay3Position);
         model = glm::scale(model, glm::vec3(programState->hayScale));
         model = glm::rotate(model, glm::radians(-37.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        hayModel.Draw(ourShader);
+        hayModel.UseTextures(model);
+        hayModel.Submit(renderQueue, ourShader, model, 2);
 
         // tractor
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->tractorPosition);
         model = glm::scale(model, glm::vec3(programState->tractorScale));
         model = glm::rotate(model, glm::radians(-6.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        tractorModel.Draw(ourShader);
+        tractorModel.UseTextures(model);
+        tractorModel.Submit(renderQueue, ourShader, model);
 
         // barn
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->cabinPosition);
         model = glm::scale(model, glm::vec3(programState->cabinScale));
         model = glm::rotate(model, glm::radians(85.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        cabinModel.Draw(ourShader);
+        cabinModel.UseTextures(model);
+        cabinModel.Submit(renderQueue, ourShader, model);
 
         // hay pile
         model = glm::mat4(1.0f);
@@ -709,8 +881,8 @@ int main() {
         model = glm::scale(model, glm::vec3(programState->hayPileScale));
         model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        hayPileModel.Draw(ourShader);
+        hayPileModel.UseTextures(model);
+        hayPileModel.Submit(renderQueue, ourShader, model);
 
         // fences
         // 1
@@ -719,72 +891,72 @@ int main() {
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 0);
         // 2
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence2Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 1);
         // 3
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence3Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 2);
         // 4
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence4Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 3);
         // 5
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence5Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 4);
         // 6
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence6Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 5);
         // 7
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence7Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 6);
         // 8
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence8Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(66.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 7);
         // 9
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->fence9Position);
         model = glm::scale(model, glm::vec3(programState->fenceScale));
         model = glm::rotate(model, glm::radians(-25.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        fenceModel.Draw(ourShader);
+        fenceModel.UseTextures(model);
+        fenceModel.Submit(renderQueue, ourShader, model, 8);
 
         // gate
         model = glm::mat4(1.0f);
@@ -792,8 +964,8 @@ int main() {
         model = glm::scale(model, glm::vec3(programState->gateScale));
         model = glm::rotate(model, glm::radians(-2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        gateModel.Draw(ourShader);
+        gateModel.UseTextures(model);
+        gateModel.Submit(renderQueue, ourShader, model);
 
         // water bowl
         model = glm::mat4(1.0f);
@@ -801,43 +973,43 @@ int main() {
         model = glm::scale(model, glm::vec3(programState->waterBowlScale));
         model = glm::rotate(model, glm::radians(-93.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        waterBowlModel.Draw(ourShader);
+        waterBowlModel.UseTextures(model);
+        waterBowlModel.Submit(renderQueue, ourShader, model);
 
         // sheep
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->sheepPosition);
         model = glm::scale(model, glm::vec3(programState->sheepScale));
         model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        sheepModel.Draw(ourShader);
+        sheepModel.UseTextures(model);
+        sheepModel.Submit(renderQueue, ourShader, model, 0);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->sheep2Position);
         model = glm::scale(model, glm::vec3(programState->sheepScale));
-        ourShader.setMat4("model", model);
-        sheepModel.Draw(ourShader);
+        sheepModel.UseTextures(model);
+        sheepModel.Submit(renderQueue, ourShader, model, 1);
 
         // water tower
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->waterTowerPosition);
         model = glm::scale(model, glm::vec3(programState->waterTowerScale));
-        ourShader.setMat4("model", model);
-        waterTowerModel.Draw(ourShader);
+        waterTowerModel.UseTextures(model);
+        waterTowerModel.Submit(renderQueue, ourShader, model);
 
         // wall lamp
         model = glm::mat4(1.0f);
         model = glm::translate(model, programState->lampPosition);
         model = glm::scale(model, glm::vec3(programState->lampScale));
-        ourShader.setMat4("model", model);
-        lampModel.Draw(ourShader);
+        lampModel.UseTextures(model);
+        lampModel.Submit(renderQueue, ourShader, model);
+
+        // the models submitted above, sorted to change as little state as possible
+        renderQueue.execute();
 
         // draw skybox
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         // skybox cube
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -848,33 +1020,17 @@ int main() {
 
         // draw grass
         blendingShader.use();
-        blendingShader.setVec3("dirLight.direction", 0.35, -1.45, -1.1);
-        blendingShader.setVec3("dirLight.ambient",  0.05f, 0.05f, 0.05f);
-        blendingShader.setVec3("dirLight.diffuse", 0.25f, 0.25f, 0.25f);
-        blendingShader.setVec3("dirLight.specular", 0.3f, 0.3f, 0.3f);
-        blendingShader.setVec3("viewPosition", programState->camera.Position);
-
-        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
-        blendingShader.setMat4("projection", projection);
-        blendingShader.setMat4("view", view);
         glBindVertexArray(transparentVAO);
         glBindTexture(GL_TEXTURE_2D, transparentTexture);
+        // the grass texture is small and the quads are close to everything, keep it whole
+        TextureResidency::instance().use(transparentTexture, (float)SCR_HEIGHT);
 
-        for (auto i : vegetation)
-        {
-            float angle = 0.0f;
-            for (int j = 0; j < 12; ++j) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, i);
-                model = glm::scale(model, glm::vec3(0.3f));
-                model = glm::rotate(model, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::translate(model, glm::vec3(-0.5f, 0.0f, 0.0f));
-                blendingShader.setMat4("model", model);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                angle += 30.0f;
-            }
-        }
+        // every clump in one draw, blending.vs turns the quads
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6 * MAX_GRASS_QUADS, (GLsizei)grassClumps.size());
+        glBindVertexArray(0);
+
+        // shrink what wasn't needed this frame if textures take more than their budget, reload what is needed again
+        TextureResidency::instance().update();
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -919,8 +1075,19 @@ int main() {
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        static bool firstFrame = true;
+        if (firstFrame)
+        {
+            std::cout << "first frame after " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            firstFrame = false;
+        }
     }
 
+    LodSelector::instance().printReport();
+    renderQueue.printReport();
+    cameraBuffer.printReport();
+    lightsBuffer.printReport();
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
@@ -933,6 +1100,9 @@ int main() {
 
     glDeleteVertexArrays(1, &transparentVAO);
     glDeleteBuffers(1, &transparentVBO);
+    glDeleteBuffers(1, &grassInstanceVBO);
+    cameraBuffer.deleteBuffer();
+    lightsBuffer.deleteBuffer();
 
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
@@ -1074,26 +1244,57 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
+    LoadProfiler::Scope profile(LoadProfiler::assetOf(faces[0]), "loadCubemap");
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
+    // the cube map bake_textures made of the faces: one file, all faces with their mip chains, uploaded as it is
+    vector<CompressedImage> baked;
+    std::string bakedPath = DdsFile::cubemapPath(faces);
+    if (ImageDecoder::preferCompressed() && DdsFile::hasFreshCubemap(faces) && DdsFile::readCubemap(bakedPath, baked))
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
+        for (unsigned int i = 0; i < baked.size(); i++)
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            DecodedImage image;
+            image.path = bakedPath;
+            image.width = baked[i].levels[0].width;
+            image.height = baked[i].levels[0].height;
+            image.compressed = baked[i];
+            TextureUploader::instance().enqueue(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, std::move(image));
         }
+        // every face has to have every level up to the max one
+        size_t levels = baked[0].levels.size();
+        for (const CompressedImage &face : baked)
+            levels = std::min(levels, face.levels.size());
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    else
+    {
+        // decode all faces in parallel, the TextureUploader streams them in as they come, so the sky shows up a few
+        // frames in. The mips are made once the last face is there, until then it samples the top level only.
+        vector<future<DecodedImage>> images = ImageDecoder::decodeAllAsync(faces);
+        std::shared_ptr<unsigned int> missing = std::make_shared<unsigned int>(faces.size());
+        std::shared_ptr<bool> failed = std::make_shared<bool>(false);
+        for (unsigned int i = 0; i < faces.size(); i++)
+            TextureUploader::instance().enqueue(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, std::move(images[i]),
+                                                [textureID, missing, failed](const DecodedImage &image) {
+                if (!image.valid())
+                {
+                    std::cout << "Cubemap texture failed to load at path: " << image.path << std::endl;
+                    *failed = true;
+                }
+                if (--*missing == 0 && !*failed)
+                {
+                    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+                    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+                    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                }
+            });
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -1104,37 +1305,9 @@ unsigned int loadCubemap(vector<std::string> faces)
 
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
\ No newline at end of file
+    // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+    LoadProfiler::Scope profile(LoadProfiler::assetOf(path), "loadTexture");
+    TextureCache &cache = TextureCache::instance();
+    unsigned int id = cache.acquirePath(path, true);
+    return id != 0 ? id : cache.acquire(ImageDecoder::decode(path, false, cache.skipResident(true)), true);
+}
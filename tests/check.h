@@ -0,0 +1,32 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cmath>
+#include <iostream>
+
+// minimal assertions for the standalone checks: a failed CHECK reports itself and the program keeps going,
+// checkResult() gives the exit code ctest looks at
+inline int &checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                                  \
+    do {                                                                                                  \
+        if (!(condition))                                                                                 \
+        {                                                                                                 \
+            std::cout << "CHECK::FAILED " << __FILE__ << ":" << __LINE__ << " " << #condition << std::endl; \
+            checkFailures()++;                                                                            \
+        }                                                                                                 \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::fabs((double)(a) - (double)(b)) <= (tolerance))
+
+inline int checkResult(const char *name)
+{
+    std::cout << name << (checkFailures() == 0 ? ": ok" : ": FAILED") << std::endl;
+    return checkFailures() == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include <learnopengl/mesh.h>
+
+#include "check.h"
+
+#include <vector>
+
+// every triangle of indices[offset, offset + count) is in exactly one batch, in order, and fits 16 bits from its base
+static bool covers(const std::vector<unsigned int> &indices, unsigned int offset, unsigned int count, const vector<IndexBatch> &batches)
+{
+    unsigned int next = offset;
+    for (const IndexBatch &batch : batches)
+    {
+        if (batch.indexOffset != next || batch.indexCount == 0 || batch.indexCount % 3 != 0)
+            return false;
+        for (unsigned int i = batch.indexOffset; i < batch.indexOffset + batch.indexCount; i++)
+            if (indices[i] < (unsigned int)batch.baseVertex || indices[i] - batch.baseVertex > 65535)
+                return false;
+        next += batch.indexCount;
+    }
+    return next == offset + count;
+}
+
+int main()
+{
+    // a strip of triangles walking through 200000 vertices, like the vertex fetch order leaves them
+    std::vector<unsigned int> indices;
+    for (unsigned int v = 0; v + 2 < 200000; v++)
+    {
+        indices.push_back(v);
+        indices.push_back(v + 1);
+        indices.push_back(v + 2);
+    }
+    unsigned int count = (unsigned int)indices.size();
+
+    vector<IndexBatch> batches;
+    CHECK(splitIndexRange(indices.data(), 0, count, batches));
+    CHECK(covers(indices, 0, count, batches));
+    // 200000 vertices need at least four 16 bit ranges, a walk like this shouldn't need more
+    CHECK(batches.size() == 4);
+
+    // everything within 16 bits stays one batch based at its lowest vertex
+    batches.clear();
+    CHECK(splitIndexRange(indices.data(), 3000, 30000, batches));
+    CHECK(batches.size() == 1 && batches[0].baseVertex == 1000);
+    CHECK(covers(indices, 3000, 30000, batches));
+
+    // batches are appended after what is there already
+    CHECK(splitIndexRange(indices.data(), 33000, 3, batches));
+    CHECK(batches.size() == 2 && batches[1].indexOffset == 33000 && batches[1].baseVertex == 11000);
+
+    // the range spans exactly 65536 vertices: still one batch; one more and it splits
+    std::vector<unsigned int> edge = { 0, 1, 2, 65533, 65534, 65535 };
+    batches.clear();
+    CHECK(splitIndexRange(edge.data(), 0, 6, batches) && batches.size() == 1);
+    edge[5] = 65536;
+    batches.clear();
+    CHECK(splitIndexRange(edge.data(), 0, 6, batches) && batches.size() == 2 && batches[1].baseVertex == 65533);
+    CHECK(covers(edge, 0, 6, batches));
+
+    // a single triangle wider than 16 bits can't be drawn with 16 bit indices at all
+    std::vector<unsigned int> wide = { 0, 1, 2, 5, 6, 70000 };
+    batches.clear();
+    CHECK(!splitIndexRange(wide.data(), 0, 6, batches));
+
+    return checkResult("index_batch_check");
+}
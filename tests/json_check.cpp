@@ -0,0 +1,72 @@
+#include <learnopengl/json.h>
+
+#include "check.h"
+
+#include <cstring>
+#include <string>
+
+static bool parse(const char *text, JsonValue &value)
+{
+    std::string error;
+    return JsonValue::parse(text, strlen(text), value, error);
+}
+
+static bool parses(const char *text)
+{
+    JsonValue value;
+    return parse(text, value);
+}
+
+static std::string stringOf(const char *text)
+{
+    JsonValue value;
+    return parse(text, value) && value.isString() ? value.string() : std::string("<failed>");
+}
+
+int main()
+{
+    JsonValue document;
+    CHECK(parse(" { \"asset\": { \"version\": \"2.0\" }, \"scene\": 0, \"nodes\": [ { \"mesh\": 1, \"scale\": [1, 2.5, -3e2] } ],"
+                " \"flag\": true, \"nothing\": null } ", document));
+    CHECK(document.isObject() && document.size() == 5);
+    CHECK(document["asset"]["version"].string() == "2.0");
+    CHECK(document["scene"].isNumber() && document["scene"].number(-1.0) == 0.0);
+    CHECK(document["nodes"].isArray() && document["nodes"].size() == 1);
+    CHECK(document["nodes"][0]["mesh"].number() == 1.0);
+    CHECK(document["nodes"][0]["scale"][1].number() == 2.5);
+    CHECK(document["nodes"][0]["scale"][2].number() == -300.0);
+    CHECK(document["flag"].boolean(false));
+    CHECK(document["nothing"].isNull() && !document.has("nothing"));
+
+    // missing members and elements read as null and fall back to the default
+    CHECK(document["missing"]["deeper"].isNull());
+    CHECK(document["nodes"][5].number(7.0) == 7.0);
+    CHECK(document["scene"]["not an object"].isNull());
+    CHECK(!document.has("missing") && document.has("scene"));
+
+    // escapes, \u ones decoded to UTF-8
+    CHECK(stringOf("\"a\\\"b\\\\c\\/d\\n\\t\"") == "a\"b\\c/d\n\t");
+    CHECK(stringOf("\"\\u0041\\u00e9\\u20ac\"") == "A\xc3\xa9\xe2\x82\xac");
+    CHECK(stringOf("\"\\ud83d\\ude00\"") == "\xf0\x9f\x98\x80");
+    // surrogates have to come in high, low pairs
+    CHECK(!parses("\"\\ud83d\""));
+    CHECK(!parses("\"\\ud83dx\""));
+    CHECK(!parses("\"\\ud83d\\u0041\""));
+    CHECK(!parses("\"\\ude00\""));
+    CHECK(!parses("\"\\u12\""));
+    CHECK(!parses("\"\\uzzzz\""));
+
+    // malformed documents fail with a message instead of reading past the end
+    const char *malformed[] = { "", "{", "[1, 2", "{\"a\" 1}", "{\"a\": 1,}", "[1,]", "tru", "\"open", "01x", "1 2", "{} x" };
+    for (const char *text : malformed)
+        CHECK(!parses(text));
+    std::string error;
+    JsonValue value;
+    CHECK(!JsonValue::parse("[1, ?]", 6, value, error) && error.find("offset") != std::string::npos);
+
+    // nesting deeper than any real document is refused, not recursed into
+    std::string deep(100000, '[');
+    CHECK(!JsonValue::parse(deep.data(), deep.size(), value, error));
+
+    return checkResult("json_check");
+}
@@ -0,0 +1,83 @@
+#include <learnopengl/mesh_lod.h>
+
+#include "check.h"
+
+#include <vector>
+
+struct GridVertex {
+    glm::vec3 Position;
+};
+
+// a flat unit square of n x n quads in the xy plane, counter clockwise seen from +z
+static void grid(int n, std::vector<GridVertex> &vertices, std::vector<unsigned int> &indices)
+{
+    for (int y = 0; y <= n; y++)
+        for (int x = 0; x <= n; x++)
+            vertices.push_back(GridVertex{ glm::vec3((float)x / n, (float)y / n, 0.0f) });
+    for (int y = 0; y < n; y++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            unsigned int corner = y * (n + 1) + x;
+            unsigned int quad[6] = { corner, corner + 1, corner + n + 2, corner, corner + n + 2, corner + n + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// signed area of the level's triangles seen from +z
+static double levelArea(const std::vector<GridVertex> &vertices, const std::vector<unsigned int> &indices, const MeshLod &lod)
+{
+    double area = 0.0;
+    for (unsigned int i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3)
+    {
+        glm::vec3 a = vertices[indices[i]].Position, b = vertices[indices[i + 1]].Position, c = vertices[indices[i + 2]].Position;
+        area += 0.5 * ((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y));
+    }
+    return area;
+}
+
+int main()
+{
+    std::vector<GridVertex> vertices;
+    std::vector<unsigned int> indices;
+    grid(16, vertices, indices);
+    size_t fullCount = indices.size();
+
+    std::vector<MeshLod> lods;
+    MeshSimplifier::buildLods(vertices, indices, lods);
+    CHECK(lods.size() > 1);
+    CHECK(lods.size() <= MeshSimplifier::MAX_LEVELS);
+    CHECK(lods[0].indexOffset == 0 && lods[0].indexCount == fullCount);
+    for (size_t level = 0; level < lods.size(); level++)
+    {
+        const MeshLod &lod = lods[level];
+        CHECK(lod.indexCount % 3 == 0);
+        CHECK(lod.indexOffset + lod.indexCount <= indices.size());
+        if (level > 0)
+        {
+            CHECK(lod.indexOffset == lods[level - 1].indexOffset + lods[level - 1].indexCount);
+            CHECK(lod.indexCount <= lods[level - 1].indexCount * 85 / 100);
+            CHECK(lod.error >= lods[level - 1].error);
+        }
+        for (unsigned int i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3)
+        {
+            CHECK(indices[i] < vertices.size() && indices[i + 1] < vertices.size() && indices[i + 2] < vertices.size());
+            CHECK(indices[i] != indices[i + 1] && indices[i + 1] != indices[i + 2] && indices[i] != indices[i + 2]);
+        }
+        // a plane simplifies without error, and the open border keeps the outline: same area, nothing flipped
+        CHECK_NEAR(lod.error, 0.0, 1e-4);
+        CHECK_NEAR(levelArea(vertices, indices, lod), 1.0, 1e-4);
+    }
+
+    // too small to be worth a second level
+    std::vector<GridVertex> smallVertices;
+    std::vector<unsigned int> smallIndices;
+    grid(4, smallVertices, smallIndices);
+    size_t smallCount = smallIndices.size();
+    MeshSimplifier::buildLods(smallVertices, smallIndices, lods);
+    CHECK(lods.size() == 1 && lods[0].indexCount == smallCount);
+    CHECK(smallIndices.size() == smallCount);
+
+    return checkResult("mesh_lod_check");
+}
@@ -0,0 +1,80 @@
+#include <learnopengl/render_queue.h>
+
+#include "check.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+static uint64_t random64()
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value = (value << 16) ^ (uint64_t)(rand() & 0xffff);
+    return value;
+}
+
+// radixSort sorts keys, and order[i] is where sorted key i came from, ties in submission order like a stable sort
+static bool sortsLikeStableSort(const std::vector<uint64_t> &input)
+{
+    std::vector<uint64_t> keys(input), keyScratch;
+    std::vector<uint32_t> order, orderScratch;
+    RenderQueue::radixSort(keys, order, keyScratch, orderScratch);
+
+    std::vector<uint32_t> expected(input.size());
+    for (uint32_t i = 0; i < expected.size(); i++)
+        expected[i] = i;
+    std::stable_sort(expected.begin(), expected.end(), [&input](uint32_t a, uint32_t b) { return input[a] < input[b]; });
+
+    if (keys.size() != input.size() || order != expected)
+        return false;
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] != input[order[i]])
+            return false;
+    return true;
+}
+
+int main()
+{
+    srand(1);
+    CHECK(sortsLikeStableSort(std::vector<uint64_t>()));
+    CHECK(sortsLikeStableSort(std::vector<uint64_t>{ 42 }));
+
+    // full width keys, every byte differs somewhere
+    std::vector<uint64_t> keys(5000);
+    for (uint64_t &key : keys)
+        key = random64();
+    CHECK(sortsLikeStableSort(keys));
+
+    // a frame's keys: a few passes, shaders and materials, the rest depth, with plenty of ties
+    for (uint64_t &key : keys)
+        key = (uint64_t)(rand() % 2) << 60 | (uint64_t)(rand() % 3) << 52 | (uint64_t)(rand() % 20) << 36 | (uint64_t)(rand() % 50);
+    CHECK(sortsLikeStableSort(keys));
+
+    // all equal: every pass is skipped, the order stays as submitted
+    CHECK(sortsLikeStableSort(std::vector<uint64_t>(100, 0x1234567890abcdefull)));
+
+    // already sorted and reversed
+    std::vector<uint64_t> ascending(1000);
+    for (size_t i = 0; i < ascending.size(); i++)
+        ascending[i] = i << 30;
+    CHECK(sortsLikeStableSort(ascending));
+    std::reverse(ascending.begin(), ascending.end());
+    CHECK(sortsLikeStableSort(ascending));
+
+    // the scratch vectors carry over between frames of different sizes
+    std::vector<uint64_t> scratchKeys, frame;
+    std::vector<uint32_t> order, scratchOrder;
+    for (size_t size : { 300, 10, 700 })
+    {
+        frame.assign(size, 0);
+        for (uint64_t &key : frame)
+            key = random64();
+        std::vector<uint64_t> expected(frame);
+        std::sort(expected.begin(), expected.end());
+        RenderQueue::radixSort(frame, order, scratchKeys, scratchOrder);
+        CHECK(frame == expected && order.size() == size);
+    }
+
+    return checkResult("render_queue_check");
+}
@@ -0,0 +1,106 @@
+#include <learnopengl/vertex_format.h>
+
+#include "check.h"
+
+#include <cstdlib>
+
+static float unpackSnorm16(int16_t value)
+{
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+// what octDecode in the shaders does
+static glm::vec3 unpackOctahedral(const OctahedralNormal &packed)
+{
+    glm::vec3 n(unpackSnorm16(packed.x), unpackSnorm16(packed.y), 0.0f);
+    n.z = 1.0f - std::abs(n.x) - std::abs(n.y);
+    if (n.z < 0.0f)
+    {
+        float x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        n.x = x;
+        n.y = y;
+    }
+    return glm::normalize(n);
+}
+
+// the formulas next to QTangent
+static void unpackQTangent(const QTangent &packed, glm::vec3 &tangent, glm::vec3 &bitangent, glm::vec3 &normal)
+{
+    float x = unpackSnorm16(packed.x), y = unpackSnorm16(packed.y), z = unpackSnorm16(packed.z), w = unpackSnorm16(packed.w);
+    // rounding to snorm16 leaves it a hair off unit length
+    float length = std::sqrt(x * x + y * y + z * z + w * w);
+    x /= length;
+    y /= length;
+    z /= length;
+    w /= length;
+    tangent = glm::vec3(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y));
+    normal = glm::vec3(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y));
+    bitangent = glm::cross(normal, tangent) * (w < 0.0f ? -1.0f : 1.0f);
+}
+
+static glm::vec3 randomDirection()
+{
+    glm::vec3 v;
+    do
+    {
+        v = glm::vec3(rand() / (float)RAND_MAX * 2.0f - 1.0f, rand() / (float)RAND_MAX * 2.0f - 1.0f,
+                      rand() / (float)RAND_MAX * 2.0f - 1.0f);
+    } while (glm::length(v) < 0.1f || glm::length(v) > 1.0f);
+    return glm::normalize(v);
+}
+
+int main()
+{
+    CHECK(packSnorm16(0.0f) == 0);
+    CHECK(packSnorm16(1.0f) == 32767 && packSnorm16(-1.0f) == -32767);
+    CHECK(packSnorm16(2.0f) == 32767 && packSnorm16(-5.0f) == -32767);
+    CHECK(packSnorm16(0.5f) == 16384);
+
+    CHECK(packHalf(0.0f) == 0x0000 && packHalf(-0.0f) == 0x8000);
+    CHECK(packHalf(1.0f) == 0x3c00 && packHalf(-2.0f) == 0xc000 && packHalf(0.5f) == 0x3800);
+    CHECK(packHalf(65504.0f) == 0x7bff);
+    CHECK(packHalf(1e6f) == 0x7c00 && packHalf(-1e6f) == 0xfc00);
+    CHECK(packHalf(std::ldexp(1.0f, -14)) == 0x0400);   // smallest normal
+    CHECK(packHalf(std::ldexp(1.0f, -24)) == 0x0001);   // smallest denormal
+    CHECK(packHalf(std::ldexp(1.0f, -26)) == 0x0000);
+    CHECK(packHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);       // halfway, rounds to even
+    CHECK(packHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 0x3c02);
+    CHECK(packHalf(2047.5f) == 0x6800);                            // carries into the exponent
+    CHECK(packHalf(INFINITY) == 0x7c00);
+    CHECK((packHalf(NAN) & 0x7c00) == 0x7c00 && (packHalf(NAN) & 0x03ff) != 0);
+
+    const glm::vec3 axes[] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+                               glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+    for (const glm::vec3 &axis : axes)
+        CHECK(glm::dot(unpackOctahedral(packOctahedral(axis)), axis) > 0.99999f);
+
+    srand(1);
+    float worstNormal = 1.0f, worstFrame = 1.0f;
+    for (int i = 0; i < 10000; i++)
+    {
+        glm::vec3 normal = randomDirection();
+        worstNormal = std::min(worstNormal, glm::dot(unpackOctahedral(packOctahedral(normal)), normal));
+
+        glm::vec3 tangent = glm::normalize(randomDirection() - normal * glm::dot(normal, randomDirection()));
+        tangent = glm::normalize(tangent - normal * glm::dot(normal, tangent));
+        bool mirrored = i % 2 == 1;
+        glm::vec3 bitangent = glm::cross(normal, tangent) * (mirrored ? -1.0f : 1.0f);
+
+        glm::vec3 t, b, n;
+        unpackQTangent(packQTangent(tangent, bitangent, normal), t, b, n);
+        worstFrame = std::min(worstFrame, std::min(glm::dot(t, tangent), std::min(glm::dot(b, bitangent), glm::dot(n, normal))));
+    }
+    // snorm16 keeps directions within a few hundredths of a degree
+    CHECK(worstNormal > 0.99999f);
+    CHECK(worstFrame > 0.99999f);
+
+    // frames whose quaternion has w around zero (a half turn) keep their handedness
+    glm::vec3 t, b, n;
+    unpackQTangent(packQTangent(glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, -1)), t, b, n);
+    CHECK(glm::dot(t, glm::vec3(-1, 0, 0)) > 0.9999f && glm::dot(b, glm::vec3(0, 1, 0)) > 0.9999f && glm::dot(n, glm::vec3(0, 0, -1)) > 0.9999f);
+    unpackQTangent(packQTangent(glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)), t, b, n);
+    CHECK(glm::dot(b, glm::vec3(0, -1, 0)) > 0.9999f && glm::dot(n, glm::vec3(0, 0, -1)) > 0.9999f);
+
+    return checkResult("vertex_format_check");
+}
@@ -0,0 +1,178 @@
+// Asset packer: writes everything under resources/ into resources/assets.pack (see AssetPack), which the program maps
+// once at startup instead of opening every model, buffer, texture and shader on its own (see Assets).
+//
+// The bake is incremental: every file is hashed and compared with the index of the existing pack. If nothing was
+// added, removed or changed the pack is left alone, so the run is cheap enough to hang off every build. Otherwise
+// only the added and changed files are appended (AssetPack::append), the pack is rewritten from scratch once a
+// quarter of it is dead space. Images with a fresh baked DDS next to them are left out, the program reads the DDS.
+//
+// run it from the project root, normally through the asset_bake target which bakes the textures first:
+//   ./bake_assets            packs resources/ if anything changed
+//   ./bake_assets --force    rewrites the whole pack even if it is up to date
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+static const char *PACK_PATH = "resources/assets.pack";
+
+static bool endsWith(const std::string &path, const std::string &suffix)
+{
+    return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// never packed: the mesh cache and the program state are written at run time, .tmp files are half written
+static bool excluded(const std::string &path)
+{
+    return path == PACK_PATH || path == "resources/cache" || path == "resources/program_state.txt" || endsWith(path, ".tmp");
+}
+
+static bool newerOrSame(const std::string &path, const std::string &than)
+{
+    struct stat a, b;
+    return stat(path.c_str(), &a) == 0 && stat(than.c_str(), &b) == 0 && a.st_mtime >= b.st_mtime;
+}
+
+// a source image the runtime never reads as long as bake_textures' output for it is fresh (see DdsFile): the
+// texture's <image>.dds, or <directory>.dds for the faces of a cube map
+static bool bakedAway(const std::string &path, const std::set<std::string> &files)
+{
+    static const char *images[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+    bool image = false;
+    for (const char *extension : images)
+        image = image || endsWith(path, extension);
+    if (!image)
+        return false;
+    std::string variant = path + ".dds";
+    std::string cubemap = path.substr(0, path.find_last_of('/')) + ".dds";
+    return (files.count(variant) && newerOrSame(variant, path)) || (files.count(cubemap) && newerOrSame(cubemap, path));
+}
+
+static void listFiles(const std::string &directory, std::vector<std::string> &files)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(dir))
+        if (entry->d_name[0] != '.')
+            entries.push_back(directory + "/" + entry->d_name);
+    closedir(dir);
+    std::sort(entries.begin(), entries.end());
+
+    for (const std::string &entry : entries)
+    {
+        struct stat st;
+        if (excluded(entry) || stat(entry.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            listFiles(entry, files);
+        else if (S_ISREG(st.st_mode))
+            files.push_back(entry);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool force = argc > 1 && strcmp(argv[1], "--force") == 0;
+
+    std::vector<std::string> listed, files;
+    listFiles("resources", listed);
+    std::set<std::string> all(listed.begin(), listed.end());
+    unsigned int baked = 0;
+    for (const std::string &file : listed)
+    {
+        if (bakedAway(file, all))
+            baked++;
+        else
+            files.push_back(file);
+    }
+
+    std::shared_ptr<AssetPack> previous = AssetPack::open(PACK_PATH);
+    std::map<std::string, const AssetPack::Entry*> previousEntries;
+    if (previous)
+        for (const AssetPack::Entry &entry : previous->entries())
+            previousEntries[entry.path] = &entry;
+
+    // everything that goes into the pack, and of it what the pack doesn't hold yet
+    std::vector<AssetPack::Source> sources, fresh;
+    std::vector<AssetPack::Entry> kept;
+    unsigned int added = 0, changed = 0, unchanged = 0;
+    size_t bytes = 0, keptBytes = 0, freshBytes = 0;
+    for (const std::string &file : files)
+    {
+        AssetPack::Source source;
+        source.path = file;
+        source.data = MappedFile::open(file);
+        if (!source.data)
+        {
+            std::cout << "ERROR::BAKE_ASSETS:: can't read " << file << ", left out" << std::endl;
+            continue;
+        }
+        source.contentHash = hashBytes(source.data->data(), source.data->size());
+        bytes += source.data->size();
+
+        std::map<std::string, const AssetPack::Entry*>::iterator old = previousEntries.find(file);
+        if (old == previousEntries.end())
+        {
+            std::cout << "added   " << file << std::endl;
+            added++;
+        }
+        else if (old->second->contentHash != source.contentHash || old->second->size != source.data->size())
+        {
+            std::cout << "changed " << file << std::endl;
+            changed++;
+        }
+        else
+        {
+            unchanged++;
+            kept.push_back(*old->second);
+            keptBytes += source.data->size();
+        }
+        if (kept.empty() || kept.back().path != file)
+        {
+            fresh.push_back(source);
+            freshBytes += source.data->size();
+        }
+        if (old != previousEntries.end())
+            previousEntries.erase(old);
+        sources.push_back(source);
+    }
+    for (const std::pair<const std::string, const AssetPack::Entry*> &removed : previousEntries)
+        std::cout << "removed " << removed.first << std::endl;
+
+    if (!force && previous && added == 0 && changed == 0 && previousEntries.empty())
+    {
+        std::cout << PACK_PATH << " is up to date (" << unchanged << " files)" << std::endl;
+        return 0;
+    }
+
+    // append while what the pack no longer uses stays under a quarter of it
+    size_t packBytes = previous ? previous->size() : 0;
+    bool append = !force && previous && (packBytes - keptBytes) * 4 < packBytes + freshBytes;
+    previous.reset();
+    if (append && !AssetPack::append(PACK_PATH, kept, fresh))
+    {
+        std::cout << "ERROR::BAKE_ASSETS:: failed to append to " << PACK_PATH << ", rewriting it" << std::endl;
+        append = false;
+    }
+    if (!append && !AssetPack::write(PACK_PATH, sources))
+    {
+        std::cout << "ERROR::BAKE_ASSETS:: failed to write " << PACK_PATH << std::endl;
+        return 1;
+    }
+    std::cout << (append ? "appended " : "packed ") << (append ? fresh.size() : sources.size()) << " files ("
+              << added << " added, " << changed << " changed, " << previousEntries.size() << " removed, " << unchanged
+              << " unchanged, " << baked << " left to their baked DDS), " << (append ? freshBytes : bytes) / 1024
+              << " KiB into " << PACK_PATH << std::endl;
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Offline texture baker: converts the PNG/JPEG textures of the models into block compressed .dds files with a full
+// mip chain next to the originals, which the program then uploads as they are instead of decoding the image and
+// generating mipmaps at load time (see ImageDecoder and DdsFile).
+//
+// Skyboxes (a directory holding right, left, top, bottom, front and back.jpg) become a single cube map .dds next to
+// the directory, all six faces with their mip chains, which loadCubemap maps and uploads in one go.
+//
+// run it from the project root:
+//   ./bake_textures                      bakes everything in resources/objects/*/textures and the skybox
+//   ./bake_textures file.png dir ...     bakes the given files and directories
+//   ./bake_textures --cubemap dir ...    bakes the skybox in dir
+//   ./bake_textures --force ...          bakes even textures whose .dds is up to date
+#include <stb_image.h>
+
+#include <learnopengl/block_compression.h>
+#include <learnopengl/dds_file.h>
+#include <learnopengl/thread_pool.h>
+
+#include <dirent.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BakeResult
+{
+    std::string path;
+    bool ok = false;
+    std::string message;
+    size_t sourceBytes = 0;
+    size_t bakedBytes = 0;
+};
+
+static std::vector<std::string> listDirectory(const std::string &directory)
+{
+    std::vector<std::string> entries;
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+        return entries;
+    while (dirent *entry = readdir(dir))
+        if (entry->d_name[0] != '.')
+            entries.push_back(directory + "/" + entry->d_name);
+    closedir(dir);
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+
+static std::string lowercase(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+static bool isImage(const std::string &path)
+{
+    std::string name = lowercase(path);
+    for (const char *extension : { ".png", ".jpg", ".jpeg", ".tga", ".bmp" })
+        if (name.size() > strlen(extension) && name.compare(name.size() - strlen(extension), std::string::npos, extension) == 0)
+            return true;
+    return false;
+}
+
+static bool isDirectory(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static BakeResult bake(const std::string &path)
+{
+    BakeResult result;
+    result.path = path;
+
+    int sourceComponents;
+    RgbaImage image;
+    unsigned char *pixels = stbi_load(path.c_str(), &image.width, &image.height, &sourceComponents, 4);
+    if (!pixels)
+    {
+        result.message = std::string("failed to load: ") + stbi_failure_reason();
+        return result;
+    }
+    image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+    stbi_image_free(pixels);
+
+    std::string name = lowercase(path.substr(path.find_last_of('/') + 1));
+    BlockFormat format = BlockEncoder::chooseFormat(image, name.find("normal") != std::string::npos);
+
+    std::vector<std::vector<unsigned char>> levels;
+    for (const RgbaImage &level : BlockEncoder::mipChain(image))
+    {
+        levels.push_back(BlockEncoder::encode(level, format));
+        result.bakedBytes += levels.back().size();
+    }
+    if (!DdsFile::write(DdsFile::variantPath(path), format, image.width, image.height, levels))
+    {
+        result.message = "failed to write " + DdsFile::variantPath(path);
+        return result;
+    }
+
+    // what the uncompressed upload with glGenerateMipmap costs, a third extra for the mips
+    result.sourceBytes = (size_t)image.width * image.height * sourceComponents * 4 / 3;
+    std::ostringstream message;
+    message << BlockEncoder::name(format) << " " << image.width << "x" << image.height << ", " << levels.size() << " levels";
+    result.message = message.str();
+    result.ok = true;
+    return result;
+}
+
+// in the order of the GL cube map faces, +x -x +y -y +z -z
+static std::vector<std::string> cubemapFaces(const std::string &directory)
+{
+    std::vector<std::string> faces;
+    for (const char *face : { "right", "left", "top", "bottom", "front", "back" })
+        faces.push_back(directory + "/" + face + ".jpg");
+    return faces;
+}
+
+static BakeResult bakeCubemap(const std::string &directory)
+{
+    std::vector<std::string> faces = cubemapFaces(directory);
+    BakeResult result;
+    result.path = DdsFile::cubemapPath(faces);
+
+    std::vector<RgbaImage> images(faces.size());
+    BlockFormat format = BC1;
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        int sourceComponents;
+        RgbaImage &image = images[i];
+        unsigned char *pixels = stbi_load(faces[i].c_str(), &image.width, &image.height, &sourceComponents, 4);
+        if (!pixels)
+        {
+            result.message = "failed to load " + faces[i] + ": " + stbi_failure_reason();
+            return result;
+        }
+        image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+        stbi_image_free(pixels);
+        if (image.width != image.height || image.width != images[0].width)
+        {
+            result.message = "faces have to be square and of the same size, " + faces[i] + " isn't";
+            return result;
+        }
+        // grey or not, a sky stays in color; only alpha needs the bigger format
+        if (BlockEncoder::chooseFormat(image, false) == BC3)
+            format = BC3;
+        // what the face costs uncompressed with a generated mip chain
+        result.sourceBytes += (size_t)image.width * image.height * sourceComponents * 4 / 3;
+    }
+
+    std::vector<std::vector<std::vector<unsigned char>>> levels(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        for (const RgbaImage &level : BlockEncoder::mipChain(images[i]))
+        {
+            levels[i].push_back(BlockEncoder::encode(level, format));
+            result.bakedBytes += levels[i].back().size();
+        }
+    }
+    if (!DdsFile::writeCubemap(result.path, format, images[0].width, levels))
+    {
+        result.message = "failed to write " + result.path;
+        return result;
+    }
+
+    std::ostringstream message;
+    message << BlockEncoder::name(format) << " cube map " << images[0].width << "x" << images[0].height << ", "
+            << levels[0].size() << " levels";
+    result.message = message.str();
+    result.ok = true;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    bool force = false;
+    std::vector<std::string> roots;
+    std::vector<std::string> cubemaps;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        else if (strcmp(argv[i], "--cubemap") == 0 && i + 1 < argc)
+            cubemaps.push_back(argv[++i]);
+        else
+            roots.push_back(argv[i]);
+    }
+    if (roots.empty() && cubemaps.empty())
+    {
+        for (const std::string &object : listDirectory("resources/objects"))
+            if (isDirectory(object + "/textures"))
+                roots.push_back(object + "/textures");
+        cubemaps.push_back("resources/textures/skybox");
+    }
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+    {
+        if (!isDirectory(root))
+            files.push_back(root);
+        else
+            for (const std::string &entry : listDirectory(root))
+                if (isImage(entry))
+                    files.push_back(entry);
+    }
+
+    std::vector<std::future<BakeResult>> jobs;
+    unsigned int upToDate = 0;
+    for (const std::string &file : files)
+    {
+        if (!force && DdsFile::hasFreshVariant(file))
+        {
+            upToDate++;
+            continue;
+        }
+        jobs.push_back(ThreadPool::shared().submit([file]() { return bake(file); }));
+    }
+    for (const std::string &directory : cubemaps)
+    {
+        if (!force && DdsFile::hasFreshCubemap(cubemapFaces(directory)))
+        {
+            upToDate++;
+            continue;
+        }
+        jobs.push_back(ThreadPool::shared().submit([directory]() { return bakeCubemap(directory); }));
+    }
+
+    size_t sourceBytes = 0, bakedBytes = 0;
+    unsigned int failed = 0;
+    for (std::future<BakeResult> &job : jobs)
+    {
+        BakeResult result = job.get();
+        if (!result.ok)
+        {
+            std::cout << "ERROR::BAKE_TEXTURES:: " << result.path << ": " << result.message << std::endl;
+            failed++;
+            continue;
+        }
+        std::cout << result.path << ": " << result.message << ", " << result.sourceBytes / 1024 << " KiB -> "
+                  << result.bakedBytes / 1024 << " KiB" << std::endl;
+        sourceBytes += result.sourceBytes;
+        bakedBytes += result.bakedBytes;
+    }
+
+    std::cout << "baked " << jobs.size() - failed << " textures (" << upToDate << " up to date, " << failed << " failed), "
+              << sourceBytes / 1024 << " KiB -> " << bakedBytes / 1024 << " KiB of VRAM" << std::endl;
+    return failed == 0 ? 0 : 1;
+}